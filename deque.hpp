@@ -3,337 +3,1950 @@
 
 #include "exceptions.hpp"
 
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace sjtu
 {
 
+  /**
+   * the links every element of a double_list carries.
+   */
+  struct list_hook
+  {
+    list_hook *prev = nullptr;
+    list_hook *next = nullptr;
+  };
+
+  /**
+   * intrusive doubly linked list of T objects, which must derive from
+   * list_hook. the list never allocates: its owner links and unlinks
+   * elements it manages itself, and the head and tail sentinels are
+   * members of the list, so it can be neither copied nor moved.
+   */
   template <class T>
   class double_list
   {
   public:
-    struct node
+    list_hook head;
+    list_hook tail;
+    size_t size = 0;
+    double_list()
+    {
+      head.next = &tail;
+      tail.prev = &head;
+    }
+    double_list(const double_list &) = delete;
+    double_list &operator=(const double_list &) = delete;
+
+    class iterator
+    {
+    public:
+      list_hook *current;
+      double_list *list;
+      iterator() : current(nullptr), list(nullptr) {}
+      iterator(list_hook *c, double_list *l) : current(c), list(l) {}
+      iterator operator++(int)
+      {
+        if (current == &list->tail)
+        {
+          throw sjtu::index_out_of_bound();
+        }
+        iterator it(*this);
+        current = current->next;
+        return it;
+      }
+      iterator &operator++()
+      {
+        if (current == &list->tail)
+        {
+          throw sjtu::index_out_of_bound();
+        }
+        current = current->next;
+        return *this;
+      }
+      iterator operator--(int)
+      {
+        if (current->prev == &list->head)
+        {
+          throw sjtu::index_out_of_bound();
+        }
+        iterator it(*this);
+        current = current->prev;
+        return it;
+      }
+      iterator &operator--()
+      {
+        if (current->prev == &list->head)
+        {
+          throw sjtu::index_out_of_bound();
+        }
+        current = current->prev;
+        return *this;
+      }
+      /**
+       * the element itself (not a reference to it); no load is needed,
+       * the links are part of the element.
+       */
+      T *operator*() const
+      {
+        if (!current || current == &list->head || current == &list->tail)
+          throw sjtu::index_out_of_bound();
+        return static_cast<T *>(current);
+      }
+      bool operator==(const iterator &rhs) const
+      {
+        return current == rhs.current;
+      }
+      bool operator!=(const iterator &rhs) const
+      {
+        return current != rhs.current;
+      }
+    };
+    iterator begin() const
+    {
+      return iterator(head.next, const_cast<double_list *>(this));
+    }
+    iterator end() const
+    {
+      return iterator(const_cast<list_hook *>(&tail), const_cast<double_list *>(this));
+    }
+    iterator last() const
+    {
+      return iterator(tail.prev, const_cast<double_list *>(this));
+    }
+    /**
+     * link p before pos.
+     */
+    iterator insert(iterator pos, T *p)
+    {
+      list_hook *oldnode = pos.current;
+      p->prev = oldnode->prev;
+      p->next = oldnode;
+      oldnode->prev->next = p;
+      oldnode->prev = p;
+      ++size;
+      return iterator(p, this);
+    }
+    /**
+     * unlink the element at pos, which stays alive, and return the
+     * iterator following it.
+     */
+    iterator erase(iterator pos)
+    {
+      if (pos == end())
+        return pos;
+      list_hook *p = pos.current;
+      iterator nextit(p->next, this);
+      p->prev->next = p->next;
+      p->next->prev = p->prev;
+      p->prev = p->next = nullptr;
+      --size;
+      return nextit;
+    }
+    bool empty() const
+    {
+      return size == 0;
+    }
+  };
+
+  /**
+   * aggregator policies for deque. value_type is what a range of elements
+   * sums up to: lift(x) for a single element x, identity() for no
+   * elements, and combine(a, b), which must be associative, for a range
+   * followed by another one. the deque keeps one such summary per block,
+   * so that aggregate(l, r) can combine whole blocks at once.
+   *
+   * no_aggregate, the default, keeps no summaries and costs nothing.
+   *
+   * with range updates (see block_tag), a policy may also say how a
+   * summary changes when every element of a block is updated at once:
+   * add(total, delta, n) when delta is added to each of n elements, and
+   * assign(value, n) when n elements are set to value. the built-in
+   * policies do; for others, updated blocks are folded again.
+   */
+  struct no_aggregate
+  {
+    typedef void value_type;
+  };
+  template <class T>
+  struct sum_aggregate
+  {
+    typedef T value_type;
+    static T identity()
+    {
+      return T();
+    }
+    static const T &lift(const T &x)
+    {
+      return x;
+    }
+    static T combine(const T &a, const T &b)
+    {
+      return a + b;
+    }
+    static T add(const T &total, const T &delta, size_t n)
+    {
+      return total + delta * T(n);
+    }
+    static T assign(const T &value, size_t n)
+    {
+      return value * T(n);
+    }
+  };
+  template <class T>
+  struct min_aggregate
+  {
+    typedef T value_type;
+    static T identity()
+    {
+      return std::numeric_limits<T>::max();
+    }
+    static const T &lift(const T &x)
+    {
+      return x;
+    }
+    static T combine(const T &a, const T &b)
+    {
+      return b < a ? b : a;
+    }
+    static T add(const T &total, const T &delta, size_t)
+    {
+      return total + delta;
+    }
+    static T assign(const T &value, size_t)
+    {
+      return value;
+    }
+  };
+  template <class T>
+  struct max_aggregate
+  {
+    typedef T value_type;
+    static T identity()
+    {
+      return std::numeric_limits<T>::lowest();
+    }
+    static const T &lift(const T &x)
+    {
+      return x;
+    }
+    static T combine(const T &a, const T &b)
+    {
+      return a < b ? b : a;
+    }
+    static T add(const T &total, const T &delta, size_t)
+    {
+      return total + delta;
+    }
+    static T assign(const T &value, size_t)
+    {
+      return value;
+    }
+  };
+
+  template <class Aggregate, class T, class = void>
+  struct updates_summary : std::false_type
+  {
+  };
+  template <class Aggregate, class T>
+  struct updates_summary<Aggregate, T,
+                         std::void_t<decltype(Aggregate::add(Aggregate::identity(), std::declval<const T &>(), size_t())),
+                                     decltype(Aggregate::assign(std::declval<const T &>(), size_t()))>>
+      : std::true_type
+  {
+  };
+
+  /**
+   * whether x += y compiles for T; only range_add needs it, so deques of
+   * types without it can still use range_assign.
+   */
+  template <class T, class = void>
+  struct addable : std::false_type
+  {
+  };
+  template <class T>
+  struct addable<T, std::void_t<decltype(std::declval<T &>() += std::declval<const T &>())>> : std::true_type
+  {
+  };
+
+  /**
+   * the summary a block keeps for its aggregator policy. the block
+   * mutators keep it exact: elements added at either end are combined in,
+   * and a block changed in the middle, which costs O(capa) anyway, is
+   * folded again. only an erasure at either end cannot be followed with
+   * combine; it marks the summary stale, and the block is folded again
+   * when the summary is next asked for, also by a const aggregate().
+   */
+  template <class Aggregate>
+  struct block_summary
+  {
+    mutable typename Aggregate::value_type total = Aggregate::identity();
+    mutable bool stale = false;
+  };
+  template <>
+  struct block_summary<no_aggregate>
+  {
+  };
+
+  /**
+   * an update of every element of a block that has not been applied to
+   * them yet: add tag_value to each, or set each to tag_value. blocks
+   * only carry one in deques with range updates enabled, since every
+   * access to an element then has to check for it.
+   */
+  template <class T, bool Enabled>
+  struct block_tag
+  {
+    enum tag_kind_t : unsigned char
+    {
+      no_tag,
+      add_tag,
+      set_tag
+    } tag_kind = no_tag;
+    T tag_value = T();
+  };
+  template <class T>
+  struct block_tag<T, false>
+  {
+  };
+
+  template <class T, class Alloc = std::allocator<T>, class Aggregate = no_aggregate, bool Tagged = false>
+  class CircularArray : public list_hook, public block_summary<Aggregate>, public block_tag<T, Tagged>
+  {
+    typedef std::allocator_traits<Alloc> alloc_traits;
+    typedef block_tag<T, Tagged> tag_type;
+    typedef block_summary<Aggregate> summary_type;
+    static const bool aggregated = !std::is_same<Aggregate, no_aggregate>::value;
+
+  public:
+    /**
+     * a block is its own node in the chain of its deque. elements live
+     * directly in arr, which is raw storage for capa objects obtained
+     * from alloc; slot i holds a constructed T iff it is one of the size_
+     * slots starting at head (wrapping around); capa must be a power of
+     * two. all blocks of one deque carry equal allocators, so elements
+     * may be relocated between them freely.
+     */
+    Alloc alloc;
+    T *arr = nullptr;
+    size_t head = 0;
+    size_t size_ = 0, capa;
+    /**
+     * chunk and tag from which the owning BlockDirectory derives the slot
+     * of this block.
+     */
+    size_t ord = 0, chunk = 0;
+    CircularArray(size_t c, const Alloc &a = Alloc()) : alloc(a), capa(c)
+    {
+      arr = alloc_traits::allocate(alloc, capa);
+    }
+    ~CircularArray()
+    {
+      clear();
+      alloc_traits::deallocate(alloc, arr, capa);
+    }
+    bool full() const
+    {
+      return size_ == capa;
+    }
+    bool empty() const
+    {
+      return size_ == 0;
+    }
+    /**
+     * i modulo capa. capacities are powers of two, so this is a mask
+     * instead of a division.
+     */
+    size_t wrap(size_t i) const
+    {
+      return i & (capa - 1);
+    }
+    /**
+     * physical address of the n-th element (n may be size_ for the
+     * first free slot behind the last element).
+     */
+    T *slot(size_t n) const
+    {
+      return arr + wrap(head + n);
+    }
+    T &operator[](size_t n)
+    {
+      settle();
+      return *slot(n);
+    }
+    bool owns(const T *p) const
+    {
+      return p >= arr && p < arr + capa;
+    }
+
+    /**
+     * move the object at src into the raw slot dst and end the lifetime
+     * of src.
+     */
+    void relocate(T *dst, T *src)
+    {
+      alloc_traits::construct(alloc, dst, std::move(*src));
+      alloc_traits::destroy(alloc, src);
+    }
+
+    /**
+     * apply the pending tag, if any, to the elements. every access to
+     * their values goes through here; moving them around inside the block
+     * or destroying them does not need to, and the summary stays as it
+     * is. if T's += or = throws, the tag is dropped with only some of the
+     * elements updated, and the summary is marked stale to match them.
+     */
+    void settle()
+    {
+      if constexpr (Tagged)
+      {
+        if (this->tag_kind != this->no_tag)
+        {
+          try
+          {
+            for (size_t i = 0; i < size_; ++i)
+            {
+              if (this->tag_kind == this->add_tag)
+                add_to(*slot(i), this->tag_value);
+              else
+                *slot(i) = this->tag_value;
+            }
+          }
+          catch (...)
+          {
+            this->tag_kind = this->no_tag;
+            mark_stale();
+            throw;
+          }
+          this->tag_kind = this->no_tag;
+        }
+      }
+    }
+    /**
+     * the value x stands for under the pending tag.
+     */
+    T tagged(const T &x) const
+    {
+      if (this->tag_kind == this->set_tag)
+        return this->tag_value;
+      T y(x);
+      add_to(y, this->tag_value);
+      return y;
+    }
+    /**
+     * x += delta. an add tag is only ever recorded by range_add, which
+     * requires it, so the other branch is never reached.
+     */
+    static void add_to(T &x, const T &delta)
+    {
+      if constexpr (addable<T>::value)
+        x += delta;
+    }
+
+    /**
+     * summary upkeep, all no-ops without an aggregator: the last (first)
+     * k elements are new, the elements changed in a way combine cannot
+     * follow, or the summary is recomputed right away.
+     */
+    void grow_back(size_t k)
+    {
+      if constexpr (aggregated)
+      {
+        if (!this->stale)
+          this->total = Aggregate::combine(this->total, fold(size_ - k, size_));
+      }
+    }
+    void grow_front(size_t k)
+    {
+      if constexpr (aggregated)
+      {
+        if (!this->stale)
+          this->total = Aggregate::combine(fold(0, k), this->total);
+      }
+    }
+    void mark_stale()
+    {
+      if constexpr (aggregated)
+      {
+        this->stale = size_ > 0;
+        if (!this->stale)
+          this->total = Aggregate::identity();
+      }
+    }
+    void refold()
+    {
+      if constexpr (aggregated)
+      {
+        this->total = fold(0, size_);
+        this->stale = false;
+      }
+    }
+
+    /**
+     * add value to (set to value) each of the elements [l, r). for the
+     * whole block this only records a tag in O(1), which later updates
+     * compose with; otherwise the elements are updated one by one.
+     */
+    template <bool Add>
+    void update(size_t l, size_t r, const T &value)
+    {
+      if (l > 0 || r < size_)
+      {
+        settle();
+        for (; l < r; ++l)
+        {
+          if constexpr (Add)
+            *slot(l) += value;
+          else
+            *slot(l) = value;
+        }
+        refold();
+        return;
+      }
+      if (Add && this->tag_kind != this->no_tag)
+        add_to(this->tag_value, value);
+      else
+      {
+        this->tag_kind = Add ? this->add_tag : this->set_tag;
+        this->tag_value = value;
+      }
+      if constexpr (updates_summary<Aggregate, T>::value)
+      {
+        if constexpr (!Add)
+          this->total = Aggregate::assign(value, size_);
+        else if (!this->stale)
+          this->total = Aggregate::add(this->total, value, size_);
+        this->stale = this->stale && Add;
+      }
+      else
+        mark_stale();
+    }
+    /**
+     * assign value to the n-th element.
+     */
+    void set(size_t n, const T &value)
+    {
+      settle();
+      *slot(n) = value;
+      refold();
+    }
+
+    /**
+     * relocate the n elements at positions [src, src + n) to
+     * [dst, dst + n); destination slots outside the source range must be
+     * raw. for trivially copyable T this is one memmove per run that is
+     * contiguous in both ranges, i.e. at most three even when the ranges
+     * wrap around, instead of a loop with modulo arithmetic per element.
+     */
+    void shift(size_t dst, size_t src, size_t n)
+    {
+      if constexpr (std::is_trivially_copyable<T>::value)
+      {
+        while (n > 0)
+        {
+          size_t len = n;
+          if (dst < src)
+          {
+            size_t ps = wrap(head + src), pd = wrap(head + dst);
+            if (len > capa - ps)
+              len = capa - ps;
+            if (len > capa - pd)
+              len = capa - pd;
+            std::memmove(static_cast<void *>(arr + pd), arr + ps, len * sizeof(T));
+            src += len;
+            dst += len;
+          }
+          else
+          {
+            // from the back, so that overlapping runs are not clobbered
+            size_t ps = wrap(head + src + n - 1) + 1, pd = wrap(head + dst + n - 1) + 1;
+            if (len > ps)
+              len = ps;
+            if (len > pd)
+              len = pd;
+            std::memmove(static_cast<void *>(arr + pd - len), arr + ps - len, len * sizeof(T));
+          }
+          n -= len;
+        }
+      }
+      else if (dst < src)
+      {
+        for (size_t i = 0; i < n; ++i)
+          relocate(slot(dst + i), slot(src + i));
+      }
+      else
+      {
+        for (size_t i = n; i > 0; --i)
+          relocate(slot(dst + i - 1), slot(src + i - 1));
+      }
+    }
+
+    /**
+     * construct an element from args in the free slot behind the last
+     * (before the first) element. the block must not be full.
+     */
+    template <class... Args>
+    T &emplace_back(Args &&...args)
+    {
+      settle();
+      T *p = slot(size_);
+      alloc_traits::construct(alloc, p, std::forward<Args>(args)...);
+      ++size_;
+      grow_back(1);
+      return *p;
+    }
+    template <class... Args>
+    T &emplace_front(Args &&...args)
+    {
+      settle();
+      size_t pos = wrap(head - 1);
+      T *p = arr + pos;
+      alloc_traits::construct(alloc, p, std::forward<Args>(args)...);
+      head = pos;
+      ++size_;
+      grow_front(1);
+      return *p;
+    }
+
+    /**
+     * construct k more elements at the back, value-initialized (copies of
+     * value); the block must have room for them. value-initializing a
+     * trivial T is zeroing its bytes, done with (at most two) memsets.
+     */
+    void append(size_t k)
+    {
+      settle();
+      if constexpr (std::is_trivial<T>::value)
+      {
+        size_t pos = wrap(head + size_), part = capa - pos < k ? capa - pos : k;
+        std::memset(static_cast<void *>(arr + pos), 0, part * sizeof(T));
+        std::memset(static_cast<void *>(arr), 0, (k - part) * sizeof(T));
+        size_ += k;
+        grow_back(k);
+        return;
+      }
+      for (; k > 0; --k)
+        emplace_back();
+    }
+    void append(size_t k, const T &value)
+    {
+      for (; k > 0; --k)
+        emplace_back(value);
+    }
+
+    /**
+     * construct an element from args as the n-th element, shifting
+     * whichever side of the block is shorter. the block must not be full,
+     * and args must not refer to elements of this block.
+     */
+    template <class... Args>
+    void emplace(size_t n, Args &&...args)
+    {
+      settle();
+      if (n < size_ - n)
+      {
+        head = wrap(head - 1);
+        shift(0, 1, n);
+      }
+      else
+        shift(n + 1, n, size_ - n);
+      alloc_traits::construct(alloc, slot(n), std::forward<Args>(args)...);
+      ++size_;
+      if (n == 0)
+        grow_front(1);
+      else if (n + 1 == size_)
+        grow_back(1);
+      else
+        refold();
+    }
+
+    /**
+     * destroy count elements starting from the n-th and close the gap from
+     * the shorter side.
+     */
+    void erase(size_t n, size_t count = 1)
+    {
+      // a pending tag still applies to the remaining elements
+      for (size_t i = n; i < n + count; ++i)
+        alloc_traits::destroy(alloc, slot(i));
+      if (n < size_ - count - n)
+      {
+        shift(count, 0, n);
+        head = wrap(head + count);
+      }
+      else
+        shift(n, n + count, size_ - count - n);
+      size_ -= count;
+      if (n == 0 || n == size_)
+        mark_stale();
+      else
+        refold();
+    }
+
+    /**
+     * destroy every element, leaving the block empty and dropping any
+     * pending tag. nothing has to be done per element if T is trivially
+     * destructible.
+     */
+    void clear()
+    {
+      static_cast<tag_type &>(*this) = tag_type();
+      if constexpr (!std::is_trivially_destructible<T>::value)
+      {
+        for (size_t i = 0; i < size_; ++i)
+          alloc_traits::destroy(alloc, slot(i));
+      }
+      head = size_ = 0;
+      mark_stale();
+    }
+
+    /**
+     * copy-construct the elements of other into this empty block, which
+     * must be at least as large, together with its pending tag and its
+     * summary. trivially copyable elements are copied as (at most two)
+     * raw byte ranges.
+     */
+    void copy_from(const CircularArray &other)
+    {
+      static_cast<tag_type &>(*this) = other;
+      static_cast<summary_type &>(*this) = other;
+      head = 0;
+      if constexpr (std::is_trivially_copyable<T>::value)
+      {
+        size_t part = other.capa - other.head;
+        if (part > other.size_)
+          part = other.size_;
+        std::memcpy(static_cast<void *>(arr), other.arr + other.head, part * sizeof(T));
+        std::memcpy(static_cast<void *>(arr + part), other.arr, (other.size_ - part) * sizeof(T));
+        size_ = other.size_;
+        return;
+      }
+      for (size_t i = 0; i < other.size_; ++i, ++size_)
+        alloc_traits::construct(alloc, arr + i, *other.slot(i));
+    }
+
+    /**
+     * relocate elements from the front of this block to the back of
+     * other until one of them runs out; returns how many were moved.
+     */
+    size_t transfer(CircularArray *other)
+    {
+      settle();
+      other->settle();
+      size_t n = 0;
+      while (size_ > 0 && !other->full())
+      {
+        relocate(other->slot(other->size_++), arr + head);
+        head = wrap(head + 1);
+        --size_;
+        ++n;
+      }
+      other->grow_back(n);
+      mark_stale();
+      return n;
+    }
+
+    /**
+     * relocate elements from the back of this block to the front of
+     * other until one of them runs out; returns how many were moved.
+     */
+    size_t transfer_back(CircularArray *other)
+    {
+      settle();
+      other->settle();
+      size_t n = 0;
+      while (size_ > 0 && !other->full())
+      {
+        other->head = other->wrap(other->head - 1);
+        ++other->size_;
+        relocate(other->arr + other->head, slot(--size_));
+        ++n;
+      }
+      other->grow_front(n);
+      mark_stale();
+      return n;
+    }
+
+    /**
+     * move the elements from position n onwards to the (empty) block
+     * other, which inherits the pending tag.
+     */
+    void split(size_t n, CircularArray *other)
+    {
+      static_cast<tag_type &>(*other) = *this;
+      for (size_t i = n; i < size_; ++i)
+        relocate(other->slot(other->size_++), slot(i));
+      size_ = n;
+      refold();
+      other->refold();
+    }
+
+    /**
+     * the elements [l, r) of this block (as the pending tag makes them)
+     * combined under Aggregate, and the summary of all of them, folded
+     * again only if it is stale. neither touches the elements.
+     */
+    typename Aggregate::value_type fold(size_t l, size_t r) const
+    {
+      typename Aggregate::value_type acc = Aggregate::identity();
+      for (; l < r; ++l)
+      {
+        if constexpr (Tagged)
+        {
+          if (this->tag_kind != this->no_tag)
+          {
+            acc = Aggregate::combine(acc, Aggregate::lift(tagged(*slot(l))));
+            continue;
+          }
+        }
+        acc = Aggregate::combine(acc, Aggregate::lift(*slot(l)));
+      }
+      return acc;
+    }
+    typename Aggregate::value_type summary() const
+    {
+      if (this->stale)
+      {
+        this->total = fold(0, size_);
+        this->stale = false;
+      }
+      return this->total;
+    }
+  };
+
+  /**
+   * contiguous index over the block chain of a deque, kept in sync with
+   * the double_list. entry i describes one block: the block itself and
+   * the virtual index of its first element. the logical index of an element
+   * is its virtual index minus origin, so pushing or popping at the front
+   * only moves the first base and origin. used entries are [first, last)
+   * with spare room on both sides, like the map of std::deque.
+   *
+   * the slots are grouped into chunks of 2^shift_ (about sqrt(capa)), each
+   * with an offset and a drift:
+   * - the base of slot k is arr[k].base + offset[k >> shift_], so adding a
+   *   delta to the bases of a range of slots touches the partly covered
+   *   chunks entry by entry and the others through their offset;
+   * - a block in chunk c sits in slot ord + drift[c] (ord and chunk are
+   *   kept in the block), so moving the entries of a chunk by d slots
+   *   adds d to its drift and only the entries that change chunks have to
+   *   be rewritten.
+   * inserting or erasing an entry is therefore one memmove plus
+   * O(sqrt B) work, instead of touching every block that moves.
+   */
+  template <class Block, class Alloc = std::allocator<Block>>
+  class BlockDirectory
+  {
+  public:
+    typedef Block block;
+    struct entry
+    {
+      block *blk;
+      long long base;
+    };
+
+  private:
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<entry> entry_allocator;
+    typedef std::allocator_traits<entry_allocator> entry_traits;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<long long> chunk_allocator;
+    typedef std::allocator_traits<chunk_allocator> chunk_traits;
+    entry_allocator ealloc;
+    chunk_allocator calloc;
+    /**
+     * offset and drift share one allocation of 2 * chunks(capa) values.
+     */
+    long long *offset = nullptr, *drift = nullptr;
+    size_t shift_ = 0;
+
+  public:
+    entry *arr = nullptr;
+    size_t first = 0, last = 0, capa = 0;
+    long long origin = 0;
+
+    explicit BlockDirectory(const Alloc &a = Alloc()) : ealloc(a), calloc(a)
+    {
+      regrow(8);
+    }
+    ~BlockDirectory()
+    {
+      entry_traits::deallocate(ealloc, arr, capa);
+      chunk_traits::deallocate(calloc, offset, 2 * chunks(capa, shift_));
+    }
+    /**
+     * exchange the entries with other, whose allocator must compare equal.
+     */
+    void swap(BlockDirectory &other)
+    {
+      std::swap(arr, other.arr);
+      std::swap(offset, other.offset);
+      std::swap(drift, other.drift);
+      std::swap(shift_, other.shift_);
+      std::swap(first, other.first);
+      std::swap(last, other.last);
+      std::swap(capa, other.capa);
+      std::swap(origin, other.origin);
+    }
+    block *get(size_t k) const
+    {
+      return arr[k].blk;
+    }
+    /**
+     * the slot of the block b.
+     */
+    size_t slot(const block *b) const
+    {
+      return b->ord + drift[b->chunk];
+    }
+    /**
+     * the virtual index of the first element of the block in slot k (of
+     * the block b).
+     */
+    long long base(size_t k) const
+    {
+      return arr[k].base + offset[k >> shift_];
+    }
+    long long base_of(const block *b) const
+    {
+      return base(slot(b));
+    }
+    void set_base(size_t k, long long v)
+    {
+      arr[k].base = v - offset[k >> shift_];
+    }
+    size_t size() const
+    {
+      return last - first;
+    }
+    /**
+     * the slot of the block holding virtual index v.
+     */
+    size_t find(long long v) const
+    {
+      size_t l = first, r = last - 1;
+      while (l < r)
+      {
+        size_t mid = (l + r + 1) / 2;
+        if (base(mid) <= v)
+          l = mid;
+        else
+          r = mid - 1;
+      }
+      return l;
+    }
+    /**
+     * find(v) for a valid virtual index v, trying the slot hint and its
+     * neighbours first, so that resolving an index next to a previously
+     * resolved one takes O(1).
+     */
+    size_t find(long long v, size_t hint) const
+    {
+      if (hint >= first && hint < last)
+      {
+        if (covers(hint, v))
+          return hint;
+        if (hint + 1 < last && covers(hint + 1, v))
+          return hint + 1;
+        if (hint > first && covers(hint - 1, v))
+          return hint - 1;
+      }
+      return find(v);
+    }
+    /**
+     * virtual index one past the last element.
+     */
+    long long end_base() const
+    {
+      if (first == last)
+        return origin;
+      return base(last - 1) + get(last - 1)->size_;
+    }
+
+    /**
+     * add the block p before slot k, with its first element at virtual
+     * index base. returns the slot it ends up in.
+     */
+    size_t insert(size_t k, block *p, long long base)
+    {
+      if (k - first < last - k ? first == 0 : last == capa)
+      {
+        size_t shift = first;
+        regrow(size() * 2 + 8);
+        k = k - shift + first;
+      }
+      if (k - first < last - k && first > 0)
+      {
+        --first;
+        move(first + 1, k, -1);
+        --k;
+      }
+      else
+      {
+        ++last;
+        move(k, last - 1, 1);
+      }
+      place(k, p, base);
+      return k;
+    }
+    /**
+     * drop the slots [k, k + count), closing the gap from the shorter side.
+     */
+    void erase(size_t k, size_t count = 1)
+    {
+      if (k - first < last - count - k)
+      {
+        first += count;
+        move(first - count, k, count);
+      }
+      else
+      {
+        last -= count;
+        move(k + count, last + count, -(long long)count);
+      }
+      if (first == last)
+        first = last = capa / 2;
+    }
+    /**
+     * add delta to the bases of the slots from k onwards.
+     */
+    void shift(size_t k, long long delta)
+    {
+      add(k, last, delta);
+    }
+    /**
+     * n elements were added to (removed from) the block in slot k; shift
+     * the bases on whichever side of it is shorter.
+     */
+    void grow_at(size_t k, long long n = 1)
+    {
+      if (last - 1 - k <= k - first)
+        add(k + 1, last, n);
+      else
+      {
+        add(first, k + 1, -n);
+        origin -= n;
+      }
+    }
+    void shrink_at(size_t k, long long n = 1)
+    {
+      grow_at(k, -n);
+    }
+    /**
+     * make sure k more blocks fit on either side without a regrow.
+     */
+    void reserve(size_t k)
+    {
+      if (first < k || capa - last < k)
+        regrow(size() + 2 * k);
+    }
+
+  private:
+    static size_t chunks(size_t c, size_t s)
+    {
+      return ((c - 1) >> s) + 1;
+    }
+    bool covers(size_t k, long long v) const
+    {
+      return base(k) <= v && (k + 1 == last || v < base(k + 1));
+    }
+    /**
+     * add delta to the bases of the slots [l, r).
+     */
+    void add(size_t l, size_t r, long long delta)
+    {
+      size_t g = size_t(1) << shift_;
+      for (; l < r && (l & (g - 1)); ++l)
+        arr[l].base += delta;
+      for (; l + g <= r; l += g)
+        offset[l >> shift_] += delta;
+      for (; l < r; ++l)
+        arr[l].base += delta;
+    }
+    /**
+     * put the block b into slot k, with its first element at virtual
+     * index base.
+     */
+    void place(size_t k, block *b, long long base)
+    {
+      arr[k].blk = b;
+      set_base(k, base);
+      b->chunk = k >> shift_;
+      b->ord = k - drift[b->chunk];
+    }
+    /**
+     * move the entries of the slots [l, r) by d slots; [first, last)
+     * already is the range in use afterwards. a chunk whose entries in
+     * use all come from the moved range just drifts by d, and only the
+     * entries that arrive from another chunk are rewritten; other chunks
+     * have all their moved entries rewritten.
+     */
+    void move(size_t l, size_t r, long long d)
+    {
+      if (l >= r)
+        return;
+      std::memmove(static_cast<void *>(arr + l + d), arr + l, (r - l) * sizeof(entry));
+      long long lo = l + d, hi = r + d, g = 1LL << shift_;
+      for (long long c = lo >> shift_; c <= (hi - 1) >> shift_; ++c)
+      {
+        long long cl = lo > c * g ? lo : c * g, ch = hi < (c + 1) * g ? hi : (c + 1) * g;
+        long long ul = (long long)first > c * g ? first : c * g;
+        long long uh = (long long)last < (c + 1) * g ? last : (c + 1) * g;
+        long long fl = cl, fh = ch;
+        if (cl <= ul && ch >= uh)
+        {
+          drift[c] += d;
+          if (d > 0 && c * g + d < fh)
+            fh = c * g + d;
+          if (d < 0 && (c + 1) * g + d > fl)
+            fl = (c + 1) * g + d;
+        }
+        for (long long q = fl; q < fh; ++q)
+        {
+          long long b = arr[q].base + offset[(q - d) >> shift_];
+          place(q, arr[q].blk, b);
+        }
+      }
+    }
+    void regrow(size_t c)
+    {
+      entry *old = arr;
+      long long *old_offset = offset;
+      size_t old_shift = shift_, n = size(), start = (c - n) / 2;
+      size_t s = 0;
+      while ((size_t(1) << (2 * s)) < c)
+        ++s;
+      size_t m = chunks(c, s);
+      arr = entry_traits::allocate(ealloc, c);
+      offset = chunk_traits::allocate(calloc, 2 * m);
+      drift = offset + m;
+      shift_ = s;
+      for (size_t i = 0; i < 2 * m; ++i)
+        offset[i] = 0;
+      for (size_t i = 0; i < n; ++i)
+        place(start + i, old[first + i].blk, old[first + i].base + old_offset[(first + i) >> old_shift]);
+      if (old)
+      {
+        entry_traits::deallocate(ealloc, old, capa);
+        chunk_traits::deallocate(calloc, old_offset, 2 * chunks(capa, old_shift));
+      }
+      capa = c;
+      first = start;
+      last = start + n;
+    }
+  };
+
+  /**
+   * block layout policies for deque. large_enough(c, n) tells whether
+   * blocks of capacity c suit a deque of n elements; the deque uses the
+   * smallest power of two (and at least 16) for which it holds.
+   *
+   * sqrt_layout keeps about sqrt(n) blocks of about sqrt(n) elements, so
+   * inserting or erasing in the middle costs O(sqrt n).
+   */
+  struct sqrt_layout
+  {
+    static bool large_enough(size_t c, size_t n)
+    {
+      return c * c >= n;
+    }
+  };
+  /**
+   * tiered_layout uses blocks of about n^(1/3) elements, the middle tier
+   * of a three-level tiered vector: shifting inside a block is O(n^(1/3)),
+   * the bases of the n^(2/3) blocks are shifted in O(n^(1/3)) through the
+   * chunked directory, and a split or merge moves O(n^(2/3)) directory
+   * entries, but since merging waits until two blocks fill half of one,
+   * it takes Omega(n^(1/3)) insertions or erasures at a block between one
+   * split or merge there and the next. middle insertions and erasures
+   * are thus amortized O(n^(1/3)); indexed access stays a binary search
+   * over the directory. meant for very large sequences edited in the
+   * middle.
+   */
+  struct tiered_layout
+  {
+    static bool large_enough(size_t c, size_t n)
+    {
+      return c * c * c >= n;
+    }
+  };
+
+  template <class T, class Alloc = std::allocator<T>, class Layout = sqrt_layout, class Aggregate = no_aggregate,
+            bool RangeUpdates = false>
+  class deque
+  {
+  public:
+    typedef Alloc allocator_type;
+    /**
+     * with an aggregator policy, elements change only through the deque
+     * itself (set(), the range updates, insertion and erasure), which
+     * keeps the block summaries exact; element access then yields const
+     * references.
+     */
+    typedef typename std::conditional<std::is_same<Aggregate, no_aggregate>::value, T &, const T &>::type reference;
+    typedef typename std::conditional<std::is_same<Aggregate, no_aggregate>::value, T *, const T *>::type pointer;
+
+  private:
+    typedef std::allocator_traits<Alloc> alloc_traits;
+    typedef CircularArray<T, Alloc, Aggregate, RangeUpdates> block;
+    typedef BlockDirectory<block, Alloc> directory;
+    typedef double_list<block> block_list;
+    /**
+     * alloc provides the elements, the blocks, the chain and the
+     * directory, each through its rebound allocator.
+     */
+    Alloc alloc;
+    block_list *dq = nullptr;
+    directory *dir = nullptr;
+    /**
+     * capa is the capacity of newly created blocks, a power of two. it
+     * follows block_capacity(max(size_, reserved)) and is re-derived
+     * whenever size_ has doubled or halved since the last checkpoint,
+     * rebuilding all blocks if it changed. slots is the total capacity of
+     * the linked blocks.
+     */
+    static const size_t min_capa = 16;
+    size_t capa = min_capa, size_ = 0;
+    size_t checkpoint = min_capa * min_capa;
+    size_t slots = 0, reserved = 0;
+    mutable std::atomic<size_t> finger{0};
+    /**
+     * spare[0, spare_count) are unlinked, emptied blocks of capacity capa
+     * kept for reuse, so that pushing and popping across a block boundary
+     * does not allocate each time. at most spare_max of them are kept,
+     * more while capacity() is below the amount passed to reserve();
+     * the array (of spare_room pointers) is allocated on first use.
+     */
+    static const size_t default_spare_limit = 2;
+    typedef typename alloc_traits::template rebind_alloc<block *> spare_allocator;
+    typedef std::allocator_traits<spare_allocator> spare_traits;
+    block **spare = nullptr;
+    size_t spare_count = 0, spare_room = 0, spare_max = default_spare_limit;
+
+    template <class, class, class>
+    friend class monotonic_deque;
+
+  public:
+    class iterator;
+    class const_iterator;
+
+  private:
+    /**
+     * allocate and construct (destroy and deallocate) a single U with a
+     * copy of alloc rebound to U.
+     */
+    template <class U, class... Args>
+    U *make(Args &&...args)
+    {
+      typedef typename alloc_traits::template rebind_alloc<U> U_alloc;
+      typedef std::allocator_traits<U_alloc> U_traits;
+      U_alloc a(alloc);
+      U *p = U_traits::allocate(a, 1);
+      try
+      {
+        U_traits::construct(a, p, std::forward<Args>(args)...);
+      }
+      catch (...)
+      {
+        U_traits::deallocate(a, p, 1);
+        throw;
+      }
+      return p;
+    }
+    template <class U>
+    void dispose(U *p)
+    {
+      typedef typename alloc_traits::template rebind_alloc<U> U_alloc;
+      typedef std::allocator_traits<U_alloc> U_traits;
+      U_alloc a(alloc);
+      U_traits::destroy(a, p);
+      U_traits::deallocate(a, p, 1);
+    }
+    /**
+     * give this deque an empty chain and directory (release them, together
+     * with the elements). a deque that was moved from has neither, so
+     * that moving never allocates; it behaves as an empty deque and gets
+     * them back by ensure() before it is modified. ensure(pos) also turns
+     * pos, which can then only be end(), into the new end().
+     */
+    void init()
+    {
+      dq = make<block_list>();
+      try
+      {
+        dir = make<directory>(alloc);
+      }
+      catch (...)
+      {
+        dispose(dq);
+        dq = nullptr;
+        throw;
+      }
+    }
+    void ensure()
+    {
+      if (!dq)
+        init();
+    }
+    void ensure(iterator &pos)
+    {
+      if (!dq)
+      {
+        if (pos.deq)
+          throw sjtu::invalid_iterator();
+        init();
+        pos = end();
+      }
+    }
+    void destroy()
+    {
+      release_spares();
+      if (!dq)
+        return;
+      // no recycling or rebalancing here: tearing down must not allocate
+      for (size_t i = dir->first; i < dir->last; ++i)
+        dispose(dir->get(i));
+      dispose(dq);
+      dispose(dir);
+      dq = nullptr;
+      dir = nullptr;
+    }
+    /**
+     * unlink the block b from the chain, then empty it and keep it as a
+     * spare if there is room and it has the current capacity; free it
+     * otherwise (also if the spare array cannot grow, so that erasing
+     * never throws).
+     */
+    void recycle(block *b)
+    {
+      dq->erase(list_iterator(b));
+      slots -= b->capa;
+      if (b->capa != capa || (spare_count >= spare_max && capacity() >= reserved))
+      {
+        dispose(b);
+        return;
+      }
+      b->clear();
+      try
+      {
+        push_spare(b);
+      }
+      catch (...)
+      {
+        dispose(b);
+      }
+    }
+    void push_spare(block *b)
+    {
+      if (spare_count == spare_room)
+      {
+        spare_allocator a(alloc);
+        size_t room = spare_room * 2 > spare_max ? spare_room * 2 : spare_max;
+        if (room < 4)
+          room = 4;
+        block **arr = spare_traits::allocate(a, room);
+        for (size_t i = 0; i < spare_count; ++i)
+          arr[i] = spare[i];
+        if (spare)
+          spare_traits::deallocate(a, spare, spare_room);
+        spare = arr;
+        spare_room = room;
+      }
+      spare[spare_count++] = b;
+    }
+    /**
+     * free spare blocks until at most n are left.
+     */
+    void drop_spares(size_t n)
     {
-      T *value;
-      node *prev;
-      node *next;
-      node(const T &val) : prev(nullptr), next(nullptr)
-      {
-        value = new T(val);
-      }
-      node() : prev(nullptr), next(nullptr), value(nullptr) {}
-      ~node()
+      while (spare_count > n)
+        dispose(spare[--spare_count]);
+    }
+    void release_spares()
+    {
+      drop_spares(0);
+      if (spare)
       {
-        if (value)
-          delete value;
+        spare_allocator a(alloc);
+        spare_traits::deallocate(a, spare, spare_room);
+        spare = nullptr;
+        spare_room = 0;
       }
-    };
-    node *head;
-    node *tail;
-    size_t size;
-    double_list()
+    }
+    /**
+     * exchange everything but the allocators with other.
+     */
+    void swap_storage(deque &other) noexcept
+    {
+      std::swap(dq, other.dq);
+      std::swap(dir, other.dir);
+      std::swap(capa, other.capa);
+      std::swap(size_, other.size_);
+      std::swap(checkpoint, other.checkpoint);
+      std::swap(slots, other.slots);
+      std::swap(reserved, other.reserved);
+      std::swap(spare, other.spare);
+      std::swap(spare_count, other.spare_count);
+      std::swap(spare_room, other.spare_room);
+      std::swap(spare_max, other.spare_max);
+    }
+    /**
+     * the smallest power of two (at least min_capa) that the layout finds
+     * large enough for n elements.
+     */
+    static size_t block_capacity(size_t n)
+    {
+      size_t c = min_capa;
+      while (!Layout::large_enough(c, n))
+        c *= 2;
+      return c;
+    }
+    typename block_list::iterator list_iterator(block *b) const
     {
-      head = new node();
-      tail = new node();
-      head->next = tail;
-      tail->prev = head;
-      size = 0;
+      return typename block_list::iterator(b, dq);
     }
-    double_list(const double_list<T> &other)
+    /**
+     * the directory slot of the block holding virtual index v. finger
+     * remembers the slot found last time, so that scans by index and
+     * other nearby lookups skip the binary search. it is only a hint, and
+     * atomic so that concurrent const accesses stay race-free.
+     */
+    size_t slot_of(long long v) const
     {
-      head = new node();
-      tail = new node();
-      head->next = tail;
-      tail->prev = head;
-      size = 0;
-      for (iterator it = other.begin(); it != other.end(); ++it)
-        insert_tail(*it);
+      size_t k = dir->find(v, finger.load(std::memory_order_relaxed));
+      finger.store(k, std::memory_order_relaxed);
+      return k;
     }
-    ~double_list()
+    /**
+     * iterator to the element with logical index pos <= size_, and the
+     * element itself for pos < size_.
+     */
+    iterator iterator_at(size_t pos) const
     {
-      while (head)
+      if (pos >= size_)
       {
-        node *cur = head;
-        head = head->next;
-        delete cur;
+        if (pos > size_)
+          throw sjtu::index_out_of_bound();
+        return iterator(dq, dir, dq->end(), 0);
       }
+      long long v = (long long)pos + dir->origin;
+      size_t k = slot_of(v);
+      return iterator(dq, dir, list_iterator(dir->get(k)), v - dir->base(k));
     }
-
-    class iterator
+    T &element_at(size_t pos) const
     {
-    public:
-      node *current;
-      double_list<T> *list;
-      iterator() : current(nullptr), list(nullptr) {}
-      iterator(const iterator &t) : current(t.current), list(t.list) {}
-      ~iterator() {}
-      iterator operator++(int)
+      long long v = (long long)pos + dir->origin;
+      size_t k = slot_of(v);
+      return (*dir->get(k))[v - dir->base(k)];
+    }
+    /**
+     * link a new empty block of capacity c into the chain before it and
+     * the directory.
+     */
+    typename block_list::iterator add_block(typename block_list::iterator it, long long base, size_t c = 0)
+    {
+      if (!c)
+        c = capa;
+      size_t k = it == dq->end() ? dir->last : dir->slot(*it);
+      block *b = spare_count > 0 && spare[spare_count - 1]->capa == c ? spare[--spare_count] : make<block>(c, alloc);
+      slots += c;
+      auto result = dq->insert(it, b);
+      dir->insert(k, b, base);
+      return result;
+    }
+    /**
+     * move every element into completely filled blocks of capacity c and
+     * release the old blocks. the list keeps its identity; the directory
+     * is replaced.
+     */
+    void rebuild(size_t c)
+    {
+      // the spares have the old capacity
+      drop_spares(0);
+      capa = c;
+      directory *old = make<directory>(alloc);
+      dir->swap(*old);
+      block *tail = nullptr;
+      long long moved = 0;
+      for (size_t i = old->first; i < old->last; ++i)
       {
-        if (current == list->tail)
+        block *cur = old->get(i);
+        while (!cur->empty())
         {
-          throw sjtu::index_out_of_bound();
+          if (!tail || tail->full())
+            tail = *add_block(dq->end(), moved);
+          moved += cur->transfer(tail);
         }
-        iterator it(*this);
-        current = current->next;
-        return it;
+        recycle(cur);
       }
-      iterator &operator++()
+      dispose(old);
+    }
+    /**
+     * construct an element from args before pos, splitting pos's block if
+     * it is full. args must not refer to elements of that block.
+     */
+    template <class... Args>
+    iterator emplace_at(iterator pos, Args &&...args)
+    {
+      ensure(pos);
+      if (pos.deq != dq)
+        throw sjtu::invalid_iterator();
+      if (pos.it == dq->end())
       {
-        if (current == list->tail)
-        {
-          throw sjtu::index_out_of_bound();
-        }
-        current = current->next;
-        return *this;
+        emplace_back(std::forward<Args>(args)...);
+        return end() - 1;
       }
-      iterator operator--(int)
+      if (pos.id == 0 && pos.it == dq->begin())
       {
-        if (current->prev == list->head)
-        {
-          throw sjtu::index_out_of_bound();
-        }
-        iterator it(*this);
-        current = current->prev;
-        return it;
+        emplace_front(std::forward<Args>(args)...);
+        return begin();
       }
-      iterator &operator--()
+      block *cur = *pos.it;
+      if (cur->full())
       {
-        if (current->prev == list->head)
+        // split the block in half so the insertion has room
+        auto next = pos.it;
+        ++next;
+        auto rightit = add_block(next, dir->base_of(cur) + cur->size_ / 2);
+        block *right = *rightit;
+        cur->split(cur->size_ / 2, right);
+        if (pos.id > cur->size_)
         {
-          throw sjtu::index_out_of_bound();
+          pos.id -= cur->size_;
+          pos.it = rightit;
+          cur = right;
         }
-        current = current->prev;
+      }
+      cur->emplace(pos.id, std::forward<Args>(args)...);
+      dir->grow_at(dir->slot(cur));
+      ++size_;
+      size_t index = dir->base_of(cur) - dir->origin + pos.id;
+      if (rebalance())
+        return iterator_at(index);
+      pos.locate();
+      return pos;
+    }
+
+    /**
+     * yields the same value n times; lets insert(pos, n, value) share the
+     * range insertion.
+     */
+    struct repeat_iterator
+    {
+      const T *value;
+      size_t n;
+      const T &operator*() const
+      {
+        return *value;
+      }
+      repeat_iterator &operator++()
+      {
+        --n;
         return *this;
       }
-      T &operator*() const
+      bool operator!=(const repeat_iterator &rhs) const
       {
-        if (!current)
-        {
-          std::cerr << "Iterator current is null!" << std::endl;
-          throw sjtu::index_out_of_bound();
-        }
-        if (current == list->head || current == list->tail)
+        return n != rhs.n;
+      }
+    };
+    /**
+     * insert [first, last) before pos. the block holding pos is cut there
+     * once, the block in front of the gap is topped up and the rest goes
+     * into freshly linked full blocks, so the cost is O(k + B) for k
+     * elements rather than k separate shifts.
+     */
+    template <class InputIt>
+    iterator insert_range(iterator pos, InputIt first, InputIt last)
+    {
+      ensure(pos);
+      if (pos.deq != dq)
+        throw sjtu::invalid_iterator();
+      size_t index = pos.vpos() - dir->origin;
+      auto next = pos.it;
+      if (pos.id > 0)
+      {
+        block *cur = *pos.it;
+        ++next;
+        next = add_block(next, dir->base_of(cur) + pos.id);
+        cur->split(pos.id, *next);
+      }
+      block *tail = nullptr;
+      if (next != dq->begin())
+      {
+        auto prev = next;
+        --prev;
+        tail = *prev;
+      }
+      size_t k = 0;
+      try
+      {
+        for (; first != last; ++first, ++k)
         {
-          std::cerr << "Iterator points to head or tail!" << std::endl;
-          throw sjtu::index_out_of_bound();
+          if (!tail || tail->full())
+          {
+            long long base = tail ? dir->base_of(tail) + tail->size_ : dir->origin;
+            tail = *add_block(next, base);
+          }
+          tail->emplace_back(*first);
         }
-        return *(current->value);
       }
-      T *operator->() const noexcept
+      catch (...)
       {
-        return current->value;
+        // keep the elements inserted so far
+        if (next != dq->end())
+          dir->shift(dir->slot(*next), k);
+        size_ += k;
+        if (tail && tail->empty())
+          release(tail);
+        throw;
       }
-      bool operator==(const iterator &rhs) const
+      if (next != dq->end())
+        dir->shift(dir->slot(*next), k);
+      size_ += k;
+      if (tail)
+        merge(tail);
+      rebalance();
+      return iterator_at(index);
+    }
+
+    /**
+     * shrink to n elements by dropping the tail as a range, or grow to n by
+     * appending elements built by block::append(k, value...): the last
+     * block is topped up and the rest goes into new, completely filled
+     * blocks. the block capacity for n is chosen before growing so the
+     * new blocks need no rebuild afterwards.
+     */
+    template <class... V>
+    void resize_to(size_t n, const V &...value)
+    {
+      if (n == 0)
       {
-        return current == rhs.current;
+        clear();
+        return;
       }
-      bool operator!=(const iterator &rhs) const
+      if (n <= size_)
       {
-        return current != rhs.current;
+        drop_back(size_ - n);
+        return;
       }
-    };
-    iterator begin() const
-    {
-      iterator it;
-      it.current = head->next;
-      it.list = const_cast<double_list<T> *>(this);
-      return it;
+      ensure();
+      size_t c = block_capacity(n > reserved ? n : reserved);
+      if (c > capa)
+        rebuild(c);
+      block *last = dq->empty() ? nullptr : *dq->last();
+      try
+      {
+        while (size_ < n)
+        {
+          if (!last || last->full())
+            last = *add_block(dq->end(), dir->end_base());
+          size_t k = last->capa - last->size_;
+          if (k > n - size_)
+            k = n - size_;
+          last->append(k, value...);
+          size_ += k;
+        }
+      }
+      catch (...)
+      {
+        // keep the elements constructed so far
+        if (last && last->empty())
+          release(last);
+        size_ = dir->end_base() - dir->origin;
+        throw;
+      }
+      rebalance();
     }
-    iterator end() const
+
+    /**
+     * range_add (Add) or range_assign.
+     */
+    template <bool Add>
+    void update(size_t l, size_t r, const T &value)
     {
-      iterator it;
-      it.current = tail;
-      it.list = const_cast<double_list<T> *>(this);
-      return it;
+      static_assert(RangeUpdates, "range updates have to be enabled by the RangeUpdates parameter");
+      if (l > r || r > size_)
+        throw sjtu::index_out_of_bound();
+      // also the only range a moved-from deque, without a directory, has
+      if (l == r)
+        return;
+      // value may be an element in the range
+      T copy(value);
+      long long v = (long long)l + dir->origin, end = (long long)r + dir->origin;
+      for (size_t k = slot_of(v); v < end; ++k)
+      {
+        block *b = dir->get(k);
+        long long base = dir->base(k);
+        size_t from = v - base, to = end - base < (long long)b->size_ ? end - base : b->size_;
+        b->template update<Add>(from, to, copy);
+        v = base + to;
+      }
     }
-    iterator last()
+
+    /**
+     * remove the last k elements without going through iterators: blocks
+     * emptied completely are recycled as a whole and only the block the
+     * cut falls into is trimmed.
+     */
+    void drop_back(size_t k)
     {
-      iterator it;
-      it.current = tail->prev;
-      it.list = const_cast<double_list<T> *>(this);
-      return it;
+      size_ -= k;
+      while (k > 0)
+      {
+        block *last = *dq->last();
+        if (last->size_ <= k)
+        {
+          k -= last->size_;
+          release(last);
+        }
+        else
+        {
+          // nothing follows the last block, so no base has to change
+          last->erase(last->size_ - k, k);
+          k = 0;
+          merge(last);
+        }
+      }
+      rebalance();
     }
-    iterator insert(iterator pos, const T &val)
+
+    T &back_ref()
     {
-      // if (pos.list != this || pos.current == nullptr || pos.current == head || pos.current == tail)
-      //   throw sjtu::invalid_iterator();
-      node *newnode = new node(val);
-      node *oldnode = pos.current;
-      newnode->prev = oldnode->prev;
-      newnode->next = oldnode;
-      oldnode->prev->next = newnode;
-      oldnode->prev = newnode;
-      ++size;
-      iterator it;
-      it.current = newnode;
-      it.list = const_cast<double_list<T> *>(this);
-      return it;
+      block *last = *dq->last();
+      return (*last)[last->size_ - 1];
     }
-    iterator erase(iterator pos)
+    /**
+     * make this (empty) deque a copy of other by cloning its blocks one
+     * for one, keeping their sizes and directory bases.
+     */
+    void copy_from(const deque &other)
     {
-      if (pos == end())
-        return pos;
-      node *todel = pos.current;
-      iterator nextit;
-      nextit.current = todel->next;
-      nextit.list = pos.list;
-      todel->prev->next = todel->next;
-      todel->next->prev = todel->prev;
-      delete todel;
-      size--;
-      return nextit;
+      if (!other.dq)
+        return;
+      ensure();
+      if (capa != other.capa)
+        drop_spares(0);
+      capa = other.capa;
+      checkpoint = other.checkpoint;
+      dir->origin = other.dir->origin;
+      for (size_t i = other.dir->first; i < other.dir->last; ++i)
+      {
+        const block *src = other.dir->get(i);
+        block *b = *add_block(dq->end(), other.dir->base(i), src->capa);
+        try
+        {
+          b->copy_from(*src);
+        }
+        catch (...)
+        {
+          // keep the elements copied so far; the summary came with the
+          // whole source block
+          b->mark_stale();
+          size_ += b->size_;
+          if (b->empty())
+            release(b);
+          throw;
+        }
+        size_ += b->size_;
+      }
     }
-    void insert_head(const T &val)
+    /**
+     * move the elements of other to the back of this deque one by one and
+     * leave other empty; used when their allocators differ.
+     */
+    void move_from(deque &other)
     {
-      node *newnode = new node(val);
-      newnode->next = head->next;
-      newnode->prev = head;
-      head->next->prev = newnode;
-      head->next = newnode;
-      size++;
+      for (iterator i = other.begin(); i != other.end(); ++i)
+      {
+        i.blk->settle();
+        emplace_back(std::move(*i.p_));
+      }
+      other.clear();
     }
-    void insert_tail(const T &val)
+    /**
+     * unlink the block b from the chain and the directory and recycle it.
+     */
+    void release(block *b)
     {
-      node *newnode = new node(val);
-      newnode->prev = tail->prev;
-      newnode->next = tail;
-      tail->prev->next = newnode;
-      tail->prev = newnode;
-      size++;
+      dir->erase(dir->slot(b));
+      recycle(b);
     }
-    void delete_head()
+    /**
+     * fold the blocks in slots l and l + 1 into one when all their
+     * elements fill at most half of either; returns whether they were
+     * merged. the margin keeps a split and a merge of the same elements
+     * apart: the halves of a split block hold capa + 1 elements, so they
+     * merge only after capa / 2 erasures, and a merged block splits only
+     * after capa / 2 insertions.
+     */
+    bool merge(size_t l, size_t r)
     {
-      if (size == 0)
-        return;
-      node *todele = head->next;
-      head->next = todele->next;
-      todele->next->prev = head;
-      delete todele;
-      size--;
+      block *left = dir->get(l);
+      block *right = dir->get(r);
+      size_t total = left->size_ + right->size_;
+      size_t limit = (left->capa < right->capa ? left->capa : right->capa) / 2;
+      if (total > limit)
+        return false;
+      // move the smaller block into the larger one
+      if (left->size_ >= right->size_)
+      {
+        right->transfer(left);
+        release(right);
+      }
+      else
+      {
+        left->transfer_back(right);
+        dir->set_base(r, dir->base(l));
+        release(left);
+      }
+      return true;
     }
-    void delete_tail()
+    /**
+     * after an erase from cur, merge it with a neighbour if they fit in
+     * half a block. together with the split on insert this keeps any two
+     * adjacent blocks above half a block of elements, so
+     * B <= 4n / capa + 1 = O(n / capa).
+     */
+    void merge(block *cur)
     {
-      if (size == 0)
+      size_t k = dir->slot(cur);
+      if (k > dir->first && merge(k - 1, k))
         return;
-      node *todele = tail->prev;
-      tail->prev = todele->prev;
-      todele->prev->next = tail;
-      delete todele;
-      size--;
-    }
-    bool empty() const
-    {
-      return size == 0;
+      if (k + 1 < dir->last)
+        merge(k, k + 1);
     }
-  };
 
-  template <class T>
-  class CircularArray
-  {
-  public:
-    T **arr = nullptr;
-    size_t head = 0, tail = 0;
-    size_t size_ = 0, capa;
-    CircularArray(size_t c) : capa(c)
-    {
-      arr = new T *[capa];
-    }
-    ~CircularArray()
-    {
-      for (int i = head; i != tail; i = (i + 1) % capa)
-        delete arr[i];
-      delete[] arr;
-    }
-    bool full()
-    {
-      return size_ == capa;
-    }
-    bool empty()
-    {
-      return head == tail;
-    }
-    T *operator[](size_t n)
+    /**
+     * called after size_ changed; returns whether the blocks were rebuilt
+     * (which invalidates every iterator).
+     */
+    bool rebalance()
     {
-      return arr[n];
+      if (size_ < checkpoint * 2 && size_ * 2 >= checkpoint)
+        return false;
+      checkpoint = size_ > min_capa * min_capa ? size_ : min_capa * min_capa;
+      size_t c = block_capacity(size_ > reserved ? size_ : reserved);
+      if (c == capa)
+        return false;
+      rebuild(c);
+      return true;
     }
-  };
-
-  template <class T>
-  class deque
-  {
-  private:
-    double_list<CircularArray<T> *> *dq;
-    int capa = 256, size_ = 0;
 
   public:
-    class const_iterator;
     class iterator
     {
     private:
       /**
-       * add data members.
-       * just add whatever you want.
+       * it is the block holding the element and id its position inside
+       * the block. end() is represented by the tail sentinel of the block
+       * list with id 0, so every position has exactly one representation.
+       * blk, first_ and last_ cache the block and its storage so that ++
+       * and -- only touch the list when they cross into another block.
        */
       size_t id;
-      double_list<CircularArray<T> *> *deq;
-      typename double_list<CircularArray<T> *>::iterator it;
-      T *p_;
-      friend class deque<T>;
+      block_list *deq;
+      directory *dir;
+      typename block_list::iterator it;
+      block *blk;
+      T *p_, *first_, *last_;
+      friend class deque;
+      friend class const_iterator;
+
+      void locate()
+      {
+        if (it == deq->end())
+        {
+          blk = nullptr;
+          p_ = first_ = last_ = nullptr;
+          return;
+        }
+        blk = *it;
+        first_ = blk->arr;
+        last_ = first_ + blk->capa;
+        p_ = blk->slot(id);
+      }
+      /**
+       * the virtual index of the pointed element.
+       */
+      long long vpos() const
+      {
+        if (!dir)
+          return 0;
+        return blk ? dir->base_of(blk) + (long long)id : dir->end_base();
+      }
+      /**
+       * point to the element with virtual index v, throwing if it lies
+       * outside [begin, end].
+       */
+      void seek(long long v)
+      {
+        if (!dir)
+        {
+          if (v != 0)
+            throw sjtu::index_out_of_bound();
+          return;
+        }
+        if (blk)
+        {
+          long long base = dir->base_of(blk);
+          if (v >= base && v < base + (long long)blk->size_)
+          {
+            id = v - base;
+            p_ = blk->slot(id);
+            return;
+          }
+        }
+        if (v < dir->origin || v > dir->end_base())
+          throw sjtu::index_out_of_bound();
+        if (v == dir->end_base())
+        {
+          it = deq->end();
+          id = 0;
+        }
+        else
+        {
+          size_t k = dir->find(v, blk ? dir->slot(blk) : dir->last - 1);
+          it.current = dir->get(k);
+          id = v - dir->base(k);
+        }
+        locate();
+      }
 
     public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef typename deque::pointer pointer;
+      typedef typename deque::reference reference;
+
       /**
        * return a new iterator which points to the n-next element.
        * if there are not enough elements, the behaviour is undefined.
        * same for operator-.
        */
-      iterator() {}
-      iterator(size_t n, double_list<CircularArray<T> *> *d, typename double_list<CircularArray<T> *>::iterator od, T *ptr) : id(n), deq(d), it(od), p_(ptr) {}
+      iterator() : id(0), deq(nullptr), dir(nullptr), blk(nullptr), p_(nullptr), first_(nullptr), last_(nullptr) {}
+      iterator(block_list *d, directory *di, typename block_list::iterator od, size_t n) : id(n), deq(d), dir(di), it(od)
+      {
+        locate();
+      }
       iterator operator+(const int &n) const
       {
         iterator result = *this;
-        int rest = n;
-        while (rest)
-        {
-          auto cur = *(result.it);
-          if (cur->tail - result.id > rest)
-          {
-            result.id += rest;
-            break;
-          }
-          rest -= (cur->tail - result.id + cur->capa) % cur->capa;
-          result.it++;
-          cur = *(result.it);
-          if (result.it == deq->end())
-          {
-            --result.it;
-            result.id = cur->tail;
-            if (rest)
-              throw sjtu::index_out_of_bound();
-          }
-          else
-            result.id = cur->head;
-        }
-        result.p_ = (*result.it)->arr[result.id];
+        result.seek(vpos() + n);
         return result;
       }
       iterator operator-(const int &n) const
       {
         iterator result = *this;
-        int rest = n;
-        while (rest)
-        {
-          auto cur = *(result.it);
-          if (result.id - cur->head >= rest)
-          {
-            result.id -= rest;
-            break;
-          }
-          rest -= (result.id - cur->head + cur->capa) % cur->capa + 1;
-          result.it--;
-          cur = *(result.it);
-          result.id = (cur->tail + cur->capa - 1) % cur->capa;
-        }
-        result.p_ = (*result.it)->arr[result.id];
+        result.seek(vpos() - n);
         return result;
       }
 
@@ -346,38 +1959,16 @@ namespace sjtu
       {
         if (this->deq != rhs.deq)
           throw sjtu::invalid_iterator();
-        iterator cur = *this;
-        int diff1 = 0;
-        while (true)
-        {
-          auto cirarr = *(this->it);
-          diff1 += (cirarr->tail - cur.id + cirarr->capa) % cirarr->capa;
-          ++cur.it;
-          if (cur.it == deq->end())
-            break;
-          cur.id = (*cur.it)->head;
-        }
-        cur = rhs;
-        int diff2 = 0;
-        while (true)
-        {
-          auto cirarr = *(this->it);
-          diff2 += (cirarr->tail - cur.id + cirarr->capa) % cirarr->capa;
-          ++cur.it;
-          if (cur.it == deq->end())
-            break;
-          cur.id = (*cur.it)->head;
-        }
-        return diff2 - diff1;
+        return int(vpos() - rhs.vpos());
       }
       iterator &operator+=(const int &n)
       {
-        *this = *this + n;
+        seek(vpos() + n);
         return *this;
       }
       iterator &operator-=(const int &n)
       {
-        *this = *this - n;
+        seek(vpos() - n);
         return *this;
       }
 
@@ -387,7 +1978,7 @@ namespace sjtu
       iterator operator++(int)
       {
         iterator result = *this;
-        *this = *this + 1;
+        ++*this;
         return result;
       }
       /**
@@ -395,7 +1986,19 @@ namespace sjtu
        */
       iterator &operator++()
       {
-        *this = *this + 1;
+        if (!p_)
+          throw sjtu::index_out_of_bound();
+        if (++id < blk->size_)
+        {
+          if (++p_ == last_)
+            p_ = first_;
+        }
+        else
+        {
+          it.current = it.current->next;
+          id = 0;
+          locate();
+        }
         return *this;
       }
       /**
@@ -404,7 +2007,7 @@ namespace sjtu
       iterator operator--(int)
       {
         iterator result = *this;
-        *this = *this - 1;
+        --*this;
         return result;
       }
       /**
@@ -412,24 +2015,41 @@ namespace sjtu
        */
       iterator &operator--()
       {
-        *this = *this - 1;
+        if (id > 0)
+        {
+          --id;
+          if (p_ == first_)
+            p_ = last_;
+          --p_;
+        }
+        else
+        {
+          --it;
+          id = (*it)->size_ - 1;
+          locate();
+        }
         return *this;
       }
 
       /**
        * *it
        */
-      T &operator*() const
+      reference operator*() const
       {
         if (!p_)
           throw sjtu::runtime_error();
+        blk->settle();
         return *p_;
       }
       /**
        * it->field
+       * applying a pending range update may throw, so this is noexcept
+       * only without RangeUpdates.
        */
-      T *operator->() const noexcept
+      pointer operator->() const noexcept(!RangeUpdates)
       {
+        if (blk)
+          blk->settle();
         return p_;
       }
 
@@ -439,22 +2059,22 @@ namespace sjtu
        */
       bool operator==(const iterator &rhs) const
       {
-        return this->it == rhs.it && this->id == rhs.id;
+        return this->it == rhs.it && this->p_ == rhs.p_;
       }
       bool operator==(const const_iterator &rhs) const
       {
-        return this->it == rhs.it && this->id == rhs.id;
+        return *this == rhs.base;
       }
       /**
        * some other operator for iterators.
        */
       bool operator!=(const iterator &rhs) const
       {
-        return this->it != rhs.it || this->id != rhs.id;
+        return !(*this == rhs);
       }
       bool operator!=(const const_iterator &rhs) const
       {
-        return this->it != rhs.it || this->id != rhs.id;
+        return !(*this == rhs);
       }
     };
 
@@ -467,71 +2087,28 @@ namespace sjtu
        */
     private:
       /**
-       * add data members.
-       * just add whatever you want.
-       */
-      size_t id;
-      double_list<CircularArray<T> *> *deq;
-      typename double_list<CircularArray<T> *>::iterator it;
-      T *p_;
-      friend class deque<T>;
-
-    public:
-      /**
-       * return a new iterator which points to the n-next element.
-       * if there are not enough elements, the behaviour is undefined.
-       * same for operator-.
+       * all the work is forwarded to a plain iterator.
        */
-      const_iterator() {}
-      const_iterator(iterator ite) : id(ite.id), deq(ite.deq), it(ite.it), p_(ite.p_) {}
-      const_iterator(int n, double_list<CircularArray<T> *> *d, typename double_list<CircularArray<T> *>::iterator od, T *ptr) : id(n), deq(d), it(od), p_(ptr) {}
-      const_iterator operator+(const int &n) const
-      {
-        const_iterator result = *this;
-        int rest = n;
-        while (rest)
-        {
-          auto cur = *(result.it);
-          if (cur->tail - result.id > rest)
-          {
-            result.id += rest;
-            break;
-          }
-          rest -= (cur->tail - result.id + cur->capa) % cur->capa;
-          result.it++;
-          cur = *(result.it);
-          if (result.it == deq->end())
-          {
-            --result.it;
-            result.id = cur->tail;
-            if (rest)
-              throw sjtu::index_out_of_bound();
-          }
-          else
-            result.id = cur->head;
-        }
-        result.p_ = (*result.it)->arr[result.id];
-        return result;
+      iterator base;
+      friend class deque;
+      friend class iterator;
+
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const T *pointer;
+      typedef const T &reference;
+
+      const_iterator() {}
+      const_iterator(const iterator &ite) : base(ite) {}
+      const_iterator operator+(const int &n) const
+      {
+        return base + n;
       }
       const_iterator operator-(const int &n) const
       {
-        const_iterator result = *this;
-        int rest = n;
-        while (rest)
-        {
-          auto cur = *(result.it);
-          if (result.id - cur->head >= rest)
-          {
-            result.id -= rest;
-            break;
-          }
-          rest -= (result.id - cur->head + cur->capa) % cur->capa + 1;
-          result.it--;
-          cur = *(result.it);
-          result.id = (cur->tail + cur->capa - 1) % cur->capa;
-        }
-        result.p_ = (*result.it)->arr[result.id];
-        return result;
+        return base - n;
       }
 
       /**
@@ -539,42 +2116,18 @@ namespace sjtu
        * if they point to different vectors, throw
        * invaild_iterator.
        */
-      int operator-(const iterator &rhs) const
+      int operator-(const const_iterator &rhs) const
       {
-        if (this->deq != rhs.deq)
-          throw sjtu::invalid_iterator();
-        iterator cur = *this;
-        int diff1 = 0;
-        while (true)
-        {
-          auto cirarr = *(this->it);
-          diff1 += (cirarr->tail - cur.id + cirarr->capa) % cirarr->capa;
-          ++cur.it;
-          if (cur.it == deq->end())
-            break;
-          cur.id = (*cur.it)->head;
-        }
-        cur = rhs;
-        int diff2 = 0;
-        while (true)
-        {
-          auto cirarr = *(this->it);
-          diff2 += (cirarr->tail - cur.id + cirarr->capa) % cirarr->capa;
-          ++cur.it;
-          if (cur.it == deq->end())
-            break;
-          cur.id = (*cur.it)->head;
-        }
-        return diff2 - diff1;
+        return base - rhs.base;
       }
       const_iterator &operator+=(const int &n)
       {
-        *this = *this + n;
+        base += n;
         return *this;
       }
       const_iterator &operator-=(const int &n)
       {
-        *this = *this - n;
+        base -= n;
         return *this;
       }
 
@@ -583,16 +2136,14 @@ namespace sjtu
        */
       const_iterator operator++(int)
       {
-        iterator result = *this;
-        *this = *this + 1;
-        return result;
+        return base++;
       }
       /**
        * ++iter
        */
       const_iterator &operator++()
       {
-        *this = *this + 1;
+        ++base;
         return *this;
       }
       /**
@@ -600,34 +2151,36 @@ namespace sjtu
        */
       const_iterator operator--(int)
       {
-        iterator result = *this;
-        *this = *this - 1;
-        return result;
+        return base--;
       }
       /**
        * --iter
        */
       const_iterator &operator--()
       {
-        *this = *this - 1;
+        --base;
         return *this;
       }
 
       /**
        * *it
        */
-      T &operator*() const
+      const T &operator*() const
       {
-        if (!p_)
+        if (!base.p_)
           throw sjtu::runtime_error();
-        return *p_;
+        base.blk->settle();
+        return *base.p_;
       }
       /**
        * it->field
+       * noexcept only without RangeUpdates, as for iterator.
        */
-      T *operator->() const noexcept
+      const T *operator->() const noexcept(!RangeUpdates)
       {
-        return p_;
+        if (base.blk)
+          base.blk->settle();
+        return base.p_;
       }
 
       /**
@@ -636,22 +2189,22 @@ namespace sjtu
        */
       bool operator==(const iterator &rhs) const
       {
-        return this->it == rhs.it && this->id == rhs.id;
+        return base == rhs;
       }
       bool operator==(const const_iterator &rhs) const
       {
-        return this->it == rhs.it && this->id == rhs.id;
+        return base == rhs.base;
       }
       /**
        * some other operator for iterators.
        */
       bool operator!=(const iterator &rhs) const
       {
-        return this->it != rhs.it || this->id != rhs.id;
+        return !(base == rhs);
       }
       bool operator!=(const const_iterator &rhs) const
       {
-        return this->it != rhs.it || this->id != rhs.id;
+        return !(base == rhs.base);
       }
     };
 
@@ -660,18 +2213,59 @@ namespace sjtu
      */
     deque()
     {
-      dq = new double_list<CircularArray<T> *>;
-      CircularArray<T> *first = new CircularArray<T>(capa);
-      dq->insert_tail(first);
+      init();
     }
-    deque(const deque &other)
+    explicit deque(const Alloc &a) : alloc(a)
     {
-      dq = new double_list<CircularArray<T> *>;
-      capa = other.capa;
-      CircularArray<T> *first = new CircularArray<T>(capa);
-      dq->insert_tail(first);
-      for (auto it = other.cbegin(); it != other.cend(); ++it)
-        push_back(*it);
+      init();
+    }
+    deque(const deque &other) : alloc(alloc_traits::select_on_container_copy_construction(other.alloc))
+    {
+      init();
+      try
+      {
+        copy_from(other);
+      }
+      catch (...)
+      {
+        // no destructor runs for a constructor that throws
+        destroy();
+        throw;
+      }
+    }
+    deque(const deque &other, const Alloc &a) : alloc(a)
+    {
+      init();
+      try
+      {
+        copy_from(other);
+      }
+      catch (...)
+      {
+        // no destructor runs for a constructor that throws
+        destroy();
+        throw;
+      }
+    }
+    /**
+     * take over the blocks of other, which is left empty without a chain
+     * of its own (see init), so nothing is allocated. iterators into
+     * other now refer to this deque.
+     */
+    deque(deque &&other) noexcept : alloc(other.alloc)
+    {
+      swap_storage(other);
+    }
+    /**
+     * with an allocator that differs from other's, the blocks cannot be
+     * taken over and the elements are moved one by one instead.
+     */
+    deque(deque &&other, const Alloc &a) : alloc(a)
+    {
+      if (alloc == other.alloc)
+        swap_storage(other);
+      else
+        move_from(other);
     }
 
     /**
@@ -679,55 +2273,184 @@ namespace sjtu
      */
     ~deque()
     {
-      delete dq;
-      dq = nullptr;
+      destroy();
     }
 
     /**
      * assignment operator.
+     * the allocator is replaced only if its traits ask for propagation.
      */
     deque &operator=(const deque &other)
     {
       if (this == &other)
         return *this;
-      delete dq;
-      size_ = 0;
-      dq = new double_list<CircularArray<T> *>;
-      capa = other.capa;
-      CircularArray<T> *first = new CircularArray<T>(capa);
-      dq->insert_tail(first);
-      for (auto it = other.cbegin(); it != other.cend(); ++it)
-        push_back(*it);
+      clear();
+      if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+      {
+        if (alloc != other.alloc)
+        {
+          destroy();
+          alloc = other.alloc;
+          init();
+        }
+      }
+      copy_from(other);
+      return *this;
+    }
+    deque &operator=(deque &&other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                             alloc_traits::is_always_equal::value)
+    {
+      if (this == &other)
+        return *this;
+      clear();
+      if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+      {
+        // other keeps the old allocator, which owns the chain it gets back
+        using std::swap;
+        swap(alloc, other.alloc);
+        swap_storage(other);
+      }
+      else if (alloc == other.alloc)
+        swap_storage(other);
+      else
+        move_from(other);
       return *this;
     }
 
+    /**
+     * exchange the contents of two deques in O(1). iterators keep
+     * pointing to the same elements, now in the other container. unless
+     * the allocator propagates on swap, the allocators must compare equal.
+     */
+    void swap(deque &other) noexcept
+    {
+      if constexpr (alloc_traits::propagate_on_container_swap::value)
+      {
+        using std::swap;
+        swap(alloc, other.alloc);
+      }
+      swap_storage(other);
+    }
+    friend void swap(deque &a, deque &b) noexcept
+    {
+      a.swap(b);
+    }
+
+    allocator_type get_allocator() const
+    {
+      return alloc;
+    }
+
+    /**
+     * keep at most n emptied blocks around for reuse (default 2); extra
+     * spare blocks are freed right away. n = 0 disables the cache.
+     */
+    void set_spare_limit(size_t n)
+    {
+      drop_spares(n);
+      spare_max = n;
+    }
+    size_t spare_limit() const
+    {
+      return spare_max;
+    }
+
     /**
      * access a specified element with bound checking.
      * throw index_out_of_bound if out of bound.
      */
-    T &at(const size_t &pos)
+    reference at(const size_t &pos)
     {
       if (pos >= size_)
         throw sjtu::index_out_of_bound();
-      return *(begin() + pos);
+      return element_at(pos);
     }
     const T &at(const size_t &pos) const
     {
       if (pos >= size_)
         throw sjtu::index_out_of_bound();
-      return *(cbegin() + pos);
+      return element_at(pos);
     }
-    T &operator[](const size_t &pos)
+    reference operator[](const size_t &pos)
     {
       if (pos >= size_)
         throw sjtu::index_out_of_bound();
-      return *(begin() + pos);
+      return element_at(pos);
     }
     const T &operator[](const size_t &pos) const
     {
       if (pos >= size_)
         throw sjtu::index_out_of_bound();
-      return *(cbegin() + pos);
+      return element_at(pos);
+    }
+
+    /**
+     * assign value to the element at pos. this is how elements of a deque
+     * with an aggregator policy are modified; the summary of their block
+     * is refolded, which takes O(capa).
+     * throw index_out_of_bound if pos >= size().
+     */
+    void set(size_t pos, const T &value)
+    {
+      if (pos >= size_)
+        throw sjtu::index_out_of_bound();
+      long long v = (long long)pos + dir->origin;
+      size_t k = slot_of(v);
+      dir->get(k)->set(v - dir->base(k), value);
+    }
+
+    /**
+     * the elements with logical indices [l, r) combined under the
+     * aggregator policy, in order. blocks inside the range contribute
+     * their summaries and only the parts of the two boundary blocks are
+     * scanned, so this is O(B + capa), plus refolding the blocks that
+     * lost elements at one of their ends since their summary was last
+     * used. that refolding writes to the cached summaries, so concurrent
+     * calls on one deque are not safe even though this is const.
+     * throw index_out_of_bound if l > r or r > size().
+     */
+    typename Aggregate::value_type aggregate(size_t l, size_t r) const
+    {
+      static_assert(!std::is_same<Aggregate, no_aggregate>::value, "aggregate() needs an aggregator policy");
+      if (l > r || r > size_)
+        throw sjtu::index_out_of_bound();
+      typename Aggregate::value_type acc = Aggregate::identity();
+      // also the only range a moved-from deque, without a directory, has
+      if (l == r)
+        return acc;
+      long long v = (long long)l + dir->origin, end = (long long)r + dir->origin;
+      for (size_t k = slot_of(v); v < end; ++k)
+      {
+        block *b = dir->get(k);
+        long long base = dir->base(k);
+        size_t from = v - base, to = end - base < (long long)b->size_ ? end - base : b->size_;
+        acc = Aggregate::combine(acc, from == 0 && to == b->size_ ? b->summary() : b->fold(from, to));
+        v = base + to;
+      }
+      return acc;
+    }
+
+    /**
+     * add delta to (assign value to) every element with logical index in
+     * [l, r); needs RangeUpdates, and range_add also needs T += T. blocks
+     * inside the range only record the update as a tag, applied to their
+     * elements when they are next accessed, and the two boundary blocks
+     * are updated element by element, so this is O(B + capa) however
+     * long the range is. iterators stay valid; references and pointers
+     * to elements in the range do not. a tag is applied by the first
+     * access to its block, const ones included (front, back, const [],
+     * at and const_iterator), so with RangeUpdates even concurrent reads
+     * of one deque have to be synchronized.
+     * throw index_out_of_bound if l > r or r > size().
+     */
+    void range_add(size_t l, size_t r, const T &delta)
+    {
+      static_assert(addable<T>::value, "range_add needs T += T");
+      update<true>(l, r, delta);
+    }
+    void range_assign(size_t l, size_t r, const T &value)
+    {
+      update<false>(l, r, value);
     }
 
     /**
@@ -738,7 +2461,7 @@ namespace sjtu
     {
       if (size_ == 0)
         throw sjtu::container_is_empty();
-      return *cbegin();
+      return (**dq->begin())[0];
     }
     /**
      * access the last element.
@@ -748,7 +2471,7 @@ namespace sjtu
     {
       if (size_ == 0)
         throw sjtu::container_is_empty();
-      return *(cend() - 1);
+      return const_cast<deque *>(this)->back_ref();
     }
 
     /**
@@ -756,13 +2479,16 @@ namespace sjtu
      */
     iterator begin()
     {
+      if (!dq)
+        return iterator();
       auto first_block = dq->begin();
-      return iterator((*first_block)->head, dq, first_block, (*first_block)->arr[(*first_block)->head]);
+      if (first_block == dq->end())
+        return end();
+      return iterator(dq, dir, first_block, 0);
     }
     const_iterator cbegin() const
     {
-      auto first_block = dq->begin();
-      return const_iterator((*first_block)->head, dq, first_block, (*first_block)->arr[(*first_block)->head]);
+      return const_cast<deque *>(this)->begin();
     }
 
     /**
@@ -770,13 +2496,13 @@ namespace sjtu
      */
     iterator end()
     {
-      auto last_block = --dq->end();
-      return iterator((*last_block)->tail, dq, last_block, nullptr);
+      if (!dq)
+        return iterator();
+      return iterator(dq, dir, dq->end(), 0);
     }
     const_iterator cend() const
     {
-      auto last_block = --dq->end();
-      return iterator((*last_block)->tail, dq, last_block, nullptr);
+      return const_cast<deque *>(this)->end();
     }
 
     /**
@@ -795,13 +2521,106 @@ namespace sjtu
       return size_;
     }
 
+    /**
+     * change the number of elements to n, removing elements from the end
+     * or appending value-initialized elements (copies of value).
+     */
+    void resize(size_t n)
+    {
+      resize_to(n);
+    }
+    void resize(size_t n, const T &value)
+    {
+      // value may be an element that a rebuild moves
+      T copy(value);
+      resize_to(n, copy);
+    }
+
+    /**
+     * make room for n elements in total. the block capacity is chosen for
+     * n at once (rebuilding the blocks if it changes, which invalidates
+     * every iterator), and enough spare blocks and directory slots are
+     * allocated that growing to n elements by pushes at either end, split
+     * in any way, allocates nothing more. the room is kept, also across
+     * pops, until shrink_to_fit().
+     */
+    void reserve(size_t n)
+    {
+      if (n <= reserved)
+        return;
+      ensure();
+      reserved = n;
+      size_t c = block_capacity(size_ > n ? size_ : n);
+      if (c != capa)
+        rebuild(c);
+      if (n <= size_)
+        return;
+      // free slots in the end blocks; each end may leave one block partly
+      // unused
+      size_t room = 0;
+      if (!dq->empty())
+      {
+        block *first = *dq->begin(), *last = *dq->last();
+        room = first->capa - first->size_;
+        if (last != first)
+          room += last->capa - last->size_;
+      }
+      size_t want = n - size_ > room ? (n - size_ - room + capa - 1) / capa + 1 : 0;
+      dir->reserve(want);
+      while (spare_count < want)
+        push_spare(make<block>(capa, alloc));
+    }
+    /**
+     * give back the memory the elements do not need: forget the reserved
+     * amount, free the spare blocks and move the elements into full blocks
+     * of the capacity their number calls for. invalidates every iterator.
+     */
+    void shrink_to_fit()
+    {
+      reserved = 0;
+      release_spares();
+      if (!dq)
+        return;
+      checkpoint = size_ > min_capa * min_capa ? size_ : min_capa * min_capa;
+      rebuild(block_capacity(size_));
+      release_spares();
+    }
+    /**
+     * the number of elements the allocated blocks (linked or spare) can
+     * hold, and the number of linked blocks.
+     */
+    size_t capacity() const
+    {
+      return slots + spare_count * capa;
+    }
+    size_t block_count() const
+    {
+      return dq ? dq->size : 0;
+    }
+
     /**
      * clear all contents.
+     * every block is emptied and recycled (or freed) as a whole, so this
+     * takes O(B) besides the destructor calls. with no elements left
+     * nothing needs a rebuild: the block capacity just goes back to what
+     * the reserved amount calls for, and spares of another capacity are
+     * freed.
      */
     void clear()
     {
-      while (!empty())
-        pop_back();
+      if (empty())
+        return;
+      size_t c = block_capacity(reserved);
+      if (c != capa)
+      {
+        drop_spares(0);
+        capa = c;
+      }
+      for (size_t i = dir->first; i < dir->last; ++i)
+        recycle(dir->get(i));
+      dir->erase(dir->first, dir->size());
+      size_ = 0;
+      checkpoint = min_capa * min_capa;
     }
 
     /**
@@ -811,51 +2630,49 @@ namespace sjtu
      */
     iterator insert(iterator pos, const T &value)
     {
-      if (pos.deq != dq)
-        throw sjtu::runtime_error();
-      int sum = (*pos.it)->tail - pos.id;
-      (*pos.it)->tail++;
-      (*pos.it)->size_++;
-      if ((*pos.it)->tail == (*pos.it)->capa)
-        (*pos.it)->tail = 0;
-      for (int i = (pos.id + sum - 1) % (*pos.it)->capa, done = 0; done < sum; i = (i - 1) % (*pos.it)->capa, ++done)
-        (*pos.it)->arr[(i + 1) % (*pos.it)->capa] = (*pos.it)->arr[i];
-      (*pos.it)->arr[pos.id] = new T(value);
-      ++size_;
-      iterator iter = pos;
-      if ((*pos.it)->full())
-      {
-        int index = pos.id - (*pos.it)->head;
-        CircularArray<T> *leftarr = new CircularArray<T>(capa);
-        CircularArray<T> *rightarr = new CircularArray<T>(capa);
-        int i = 0;
-        while (i <= (*pos.it)->size_ / 2)
-        {
-          leftarr->arr[leftarr->tail++] = iter.p_;
-          leftarr->size_++;
-          i++;
-          iter++;
-        }
-        while (i < (*pos.it)->size_)
-        {
-          rightarr->arr[rightarr->tail++] = iter.p_;
-          rightarr->size_++;
-          i++;
-          iter++;
-        }
-        auto curit = dq->erase(pos.it);
-        curit = dq->insert(curit, rightarr);
-        curit = dq->insert(curit, leftarr);
-        pos.it = curit;
-        pos.id = index;
-        if(index >= (*pos.it)->size_)
-        {
-          pos.id = index - (*pos.it)->size_;
-          ++pos.it;
-        }
-        pos.p_ = (*pos.it)->arr[pos.id];
+      // opening the gap relocates elements of pos's block, value included
+      if (pos.blk && pos.deq == dq && pos.blk->owns(&value))
+      {
+        T copy(value);
+        return emplace_at(pos, std::move(copy));
       }
-      return pos;
+      return emplace_at(pos, value);
+    }
+    iterator insert(iterator pos, T &&value)
+    {
+      return emplace_at(pos, std::move(value));
+    }
+
+    /**
+     * construct an element from args before pos.
+     * return an iterator pointing to the new element.
+     * at either end the element is built directly in block storage; in
+     * the middle it is built first and then moved in, since args may
+     * refer to elements that get moved while opening the gap.
+     */
+    template <class... Args>
+    iterator emplace(iterator pos, Args &&...args)
+    {
+      if (pos.deq == dq && pos.blk && !(pos.id == 0 && pos.it == dq->begin()))
+        return emplace_at(pos, T(std::forward<Args>(args)...));
+      return emplace_at(pos, std::forward<Args>(args)...);
+    }
+
+    /**
+     * insert n copies of value (the elements of [first, last)) before
+     * pos. return an iterator pointing to the first inserted element, or
+     * pos if nothing was inserted. if a copy throws, the elements
+     * inserted before it stay in place.
+     */
+    iterator insert(iterator pos, size_t n, const T &value)
+    {
+      T copy(value);
+      return insert_range(pos, repeat_iterator{&copy, n}, repeat_iterator{&copy, 0});
+    }
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    iterator insert(iterator pos, InputIt first, InputIt last)
+    {
+      return insert_range(pos, first, last);
     }
 
     /**
@@ -870,16 +2687,75 @@ namespace sjtu
         throw sjtu::container_is_empty();
       if (pos.deq != this->dq || pos == end())
         throw sjtu::invalid_iterator();
-      int index = pos.id;
-      auto cirarr = (*pos.it);
-      delete cirarr->arr[index];
-      for (int i = (index + 1) % cirarr->capa; i != cirarr->tail; i = (i + 1) % cirarr->capa)
-        cirarr->arr[i] = cirarr->arr[i + 1];
-      cirarr->size_--;
-      cirarr->tail--;
-      size_--;
-      pos.p_ = cirarr->arr[index];
-      return pos;
+      block *cur = *pos.it;
+      size_t index = dir->base_of(cur) - dir->origin + pos.id;
+      cur->erase(pos.id);
+      dir->shrink_at(dir->slot(cur));
+      --size_;
+      if (cur->empty())
+        release(cur);
+      else
+        merge(cur);
+      rebalance();
+      return iterator_at(index);
+    }
+
+    /**
+     * remove the elements in [first, last).
+     * return an iterator pointing to the element that followed them.
+     * blocks completely inside the range are unlinked as a whole and only
+     * the two boundary blocks are trimmed, so the cost is O(k + B).
+     * throw if the iterators are invalid or last comes before first.
+     */
+    iterator erase(iterator first, iterator last)
+    {
+      if (first.deq != dq || last.deq != dq)
+        throw sjtu::invalid_iterator();
+      if (!dq)
+        return end();
+      long long k = last - first;
+      if (k < 0)
+        throw sjtu::invalid_iterator();
+      size_t index = first.vpos() - dir->origin;
+      if (k == 0)
+        return iterator_at(index);
+      block *fb = first.blk, *lb = last.blk;
+      if (fb == lb)
+      {
+        fb->erase(first.id, k);
+        dir->shrink_at(dir->slot(fb), k);
+        if (fb->empty())
+          release(fb);
+        else
+          merge(fb);
+      }
+      else
+      {
+        // the slots [s, e) are covered completely
+        size_t s = dir->slot(fb) + (first.id > 0 ? 1 : 0);
+        size_t e = lb ? dir->slot(lb) : dir->last;
+        if (first.id > 0)
+          fb->erase(first.id, fb->size_ - first.id);
+        if (lb)
+          lb->erase(0, last.id);
+        for (size_t i = s; i < e; ++i)
+        {
+          recycle(dir->get(i));
+        }
+        dir->erase(s, e - s);
+        if (lb)
+        {
+          size_t l = dir->slot(lb);
+          dir->shift(l, -k);
+          dir->set_base(l, dir->base(l) + last.id);
+          merge(lb);
+        }
+        else if (first.id > 0)
+          merge(fb);
+      }
+      size_ -= k;
+      rebalance();
+      return iterator_at(index);
     }
 
     /**
@@ -887,7 +2763,28 @@ namespace sjtu
      */
     void push_back(const T &value)
     {
-      insert(end(), value);
+      emplace_back(value);
+    }
+    void push_back(T &&value)
+    {
+      emplace_back(std::move(value));
+    }
+    /**
+     * construct an element from args at the end, in place.
+     * return a reference to it.
+     */
+    template <class... Args>
+    reference emplace_back(Args &&...args)
+    {
+      ensure();
+      block *last = dq->empty() ? nullptr : *dq->last();
+      if (!last || last->full())
+        last = *add_block(dq->end(), dir->end_base());
+      T &result = last->emplace_back(std::forward<Args>(args)...);
+      ++size_;
+      if (rebalance())
+        return back_ref();
+      return result;
     }
 
     /**
@@ -906,7 +2803,29 @@ namespace sjtu
      */
     void push_front(const T &value)
     {
-      insert(begin(), value);
+      emplace_front(value);
+    }
+    void push_front(T &&value)
+    {
+      emplace_front(std::move(value));
+    }
+    /**
+     * construct an element from args at the beginning, in place.
+     * return a reference to it.
+     */
+    template <class... Args>
+    reference emplace_front(Args &&...args)
+    {
+      ensure();
+      block *first = dq->empty() ? nullptr : *dq->begin();
+      if (!first || first->full())
+        first = *add_block(dq->begin(), dir->origin);
+      T &result = first->emplace_front(std::forward<Args>(args)...);
+      dir->grow_at(dir->slot(first));
+      ++size_;
+      if (rebalance())
+        return const_cast<T &>(front());
+      return result;
     }
 
     /**
@@ -921,6 +2840,166 @@ namespace sjtu
     }
   };
 
+  /**
+   * a sliding window over a stream that reports the least and the
+   * greatest element under Compare in O(1). elements enter at the back
+   * and leave from the front; the window itself is not stored, only the
+   * candidates for its minimum and its maximum, each in a deque:
+   * - lows holds the elements no later element is less than or equal to,
+   *   so its values increase from the front, which is the minimum; highs
+   *   likewise for the maximum.
+   * - pushing x drops the candidates it dominates, which form a suffix.
+   *   its start is found by a galloping search from the back and the
+   *   suffix goes with one deque::drop_back, which recycles the blocks it
+   *   empties as a whole, so a long run of dominated candidates costs
+   *   O(log k) comparisons and no iterator is built. every element is
+   *   pushed into and dropped from each deque at most once, so push_back
+   *   is amortized O(1).
+   * - pop_front removes the oldest element, which is a candidate only if
+   *   it is at the front of lows or highs; elements are numbered as they
+   *   arrive to tell.
+   */
+  template <class T, class Compare = std::less<T>, class Alloc = std::allocator<T>>
+  class monotonic_deque
+  {
+    struct entry
+    {
+      T value;
+      size_t seq;
+    };
+    typedef sjtu::deque<entry, typename std::allocator_traits<Alloc>::template rebind_alloc<entry>> candidates;
+    Compare comp;
+    candidates lows, highs;
+    /**
+     * the window holds the elements numbered [first, next).
+     */
+    size_t first = 0, next = 0;
+
+    /**
+     * whether x dominates the candidate y: y is not less than x (not
+     * greater than x, for highs).
+     */
+    bool dominated(const T &y, const T &x, bool low) const
+    {
+      return low ? !comp(y, x) : !comp(x, y);
+    }
+    /**
+     * drop the candidates of list that x dominates.
+     */
+    void evict(candidates &list, const T &x, bool low)
+    {
+      size_t n = list.size();
+      if (n == 0 || !dominated(list.back().value, x, low))
+        return;
+      // [hi, n) is known to be dominated, and so is nothing before lo
+      size_t hi = n - 1, step = 1;
+      while (step <= hi && dominated(list.element_at(hi - step).value, x, low))
+      {
+        hi -= step;
+        step *= 2;
+      }
+      size_t lo = step <= hi ? hi - step + 1 : 0;
+      while (lo < hi)
+      {
+        size_t mid = lo + (hi - lo) / 2;
+        if (dominated(list.element_at(mid).value, x, low))
+          hi = mid;
+        else
+          lo = mid + 1;
+      }
+      list.drop_back(n - lo);
+    }
+
+  public:
+    typedef Alloc allocator_type;
+
+    monotonic_deque() {}
+    explicit monotonic_deque(const Compare &c, const Alloc &a = Alloc())
+        : comp(c), lows(typename candidates::allocator_type(a)), highs(typename candidates::allocator_type(a))
+    {
+    }
+
+    /**
+     * add x to the back of the window.
+     */
+    void push_back(const T &x)
+    {
+      // x may be a candidate that is about to be dropped
+      push_back(T(x));
+    }
+    void push_back(T &&x)
+    {
+      evict(lows, x, true);
+      evict(highs, x, false);
+      lows.push_back(entry{x, next});
+      highs.push_back(entry{std::move(x), next});
+      ++next;
+    }
+
+    /**
+     * remove the oldest element of the window.
+     * throw container_is_empty when the window is empty.
+     */
+    void pop_front()
+    {
+      if (empty())
+        throw sjtu::container_is_empty();
+      if (lows.front().seq == first)
+        lows.pop_front();
+      if (highs.front().seq == first)
+        highs.pop_front();
+      ++first;
+    }
+
+    /**
+     * the least (greatest) element of the window; of equal ones, the
+     * latest.
+     * throw container_is_empty when the window is empty.
+     */
+    const T &min() const
+    {
+      if (empty())
+        throw sjtu::container_is_empty();
+      return lows.front().value;
+    }
+    const T &max() const
+    {
+      if (empty())
+        throw sjtu::container_is_empty();
+      return highs.front().value;
+    }
+
+    size_t size() const
+    {
+      return next - first;
+    }
+    bool empty() const
+    {
+      return first == next;
+    }
+    void clear()
+    {
+      lows.clear();
+      highs.clear();
+      first = next;
+    }
+    allocator_type get_allocator() const
+    {
+      return allocator_type(lows.get_allocator());
+    }
+  };
+
+  namespace pmr
+  {
+    /**
+     * a deque whose memory comes from a std::pmr::memory_resource.
+     */
+    template <class T, class Layout = sqrt_layout, class Aggregate = no_aggregate, bool RangeUpdates = false>
+    using deque = sjtu::deque<T, std::pmr::polymorphic_allocator<T>, Layout, Aggregate, RangeUpdates>;
+    template <class T, class Compare = std::less<T>>
+    using monotonic_deque = sjtu::monotonic_deque<T, Compare, std::pmr::polymorphic_allocator<T>>;
+  } // namespace pmr
+
 } // namespace sjtu
 
 #endif
@@ -0,0 +1,900 @@
+// checks the extended interface against std::deque or brute force.
+
+#include <iostream>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <memory_resource>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <deque>
+#include <random>
+
+#include "deque.hpp"
+
+std::default_random_engine randnum(time(NULL));
+
+static const int MAX_N = 15000;
+
+template <typename Ans, typename Test>
+bool isEqual(Ans &ans, Test &test) {
+    if (ans.size() != test.size())
+        return false;
+
+    if (ans.empty()) return true;
+
+    for (int i = 0; i < ans.size(); i++) {
+        if (ans[i] != test[i]) return false;
+    }
+
+    auto myIter = test.begin();
+    for (auto ansIter = ans.begin(); ansIter != ans.end(); ++ansIter, ++myIter)
+        if (*ansIter != *myIter) return false;
+
+    if (myIter != test.end() || ans.front() != test.front() ||
+        ans.back() != test.back())
+        return false;
+
+    return true;
+}
+
+template <typename Ans, typename Test>
+void randnumFill(Ans &ans, Test &test, int n = MAX_N) {
+    for (int i = 0; i < n; i++) {
+        int x = randnum() % 1000;
+        if (randnum() % 2) {
+            ans.push_back(x);
+            test.push_back(x);
+        } else {
+            ans.push_front(x);
+            test.push_front(x);
+        }
+    }
+}
+
+bool insertRangeTest() {
+    std::deque<int> ans;
+    sjtu::deque<int> deq;
+
+    randnumFill(ans, deq, 1000);
+
+    for (int i = 0; i < 300; i++) {
+        int pos = randnum() % (ans.size() + 1);
+        int n = randnum() % 200;
+        int x = randnum();
+        std::vector<int> vec(n);
+        std::list<int> lst;
+        for (int j = 0; j < n; j++) {
+            vec[j] = randnum();
+            lst.push_back(vec[j]);
+        }
+
+        sjtu::deque<int>::iterator it;
+        std::deque<int>::iterator ansIt;
+        switch (randnum() % 3) {
+            case 0: it = deq.insert(deq.begin() + pos, n, x);
+                    ansIt = ans.insert(ans.begin() + pos, n, x);
+                    break;
+            case 1: it = deq.insert(deq.begin() + pos, vec.begin(), vec.end());
+                    ansIt = ans.insert(ans.begin() + pos, vec.begin(), vec.end());
+                    break;
+            case 2: it = deq.insert(deq.begin() + pos, lst.begin(), lst.end());
+                    ansIt = ans.insert(ans.begin() + pos, lst.begin(), lst.end());
+                    break;
+        }
+        if (it - deq.begin() != ansIt - ans.begin())
+            return false;
+    }
+
+    return isEqual(ans, deq);
+}
+
+// copies throw once countdown runs out; moves never throw
+struct Fragile {
+    static int countdown;
+    int x;
+    Fragile(int x = 0) : x(x) {}
+    Fragile(const Fragile &other) : x(other.x) {
+        if (countdown >= 0 && countdown-- == 0)
+            throw 1;
+    }
+    Fragile(Fragile &&other) noexcept : x(other.x) {}
+    Fragile &operator=(const Fragile &other) = default;
+    Fragile &operator=(Fragile &&other) noexcept = default;
+    bool operator!=(const Fragile &other) const { return x != other.x; }
+};
+int Fragile::countdown = -1;
+
+bool insertThrowTest() {
+    for (int round = 0; round < 40; round++) {
+        std::deque<Fragile> ans;
+        sjtu::deque<Fragile> deq;
+        for (int i = 0; i < 200; i++) {
+            deq.push_back(Fragile(i)); ans.push_back(Fragile(i));
+        }
+        std::vector<Fragile> vec;
+        for (int i = 0; i < 100; i++)
+            vec.push_back(Fragile(1000 + i));
+
+        int pos = randnum() % 201;
+        bool count = randnum() % 2;
+        Fragile::countdown = randnum() % 100;
+        try {
+            if (count)
+                deq.insert(deq.begin() + pos, 100, vec[0]);
+            else
+                deq.insert(deq.begin() + pos, vec.begin(), vec.end());
+            Fragile::countdown = -1;
+            return false;
+        } catch (int) {}
+        Fragile::countdown = -1;
+
+        // the elements copied before the throw stay, in order
+        int k = deq.size() - 200;
+        if (k < 0 || k > 100)
+            return false;
+        if (count)
+            ans.insert(ans.begin() + pos, k, vec[0]);
+        else
+            ans.insert(ans.begin() + pos, vec.begin(), vec.begin() + k);
+        if (!isEqual(ans, deq) || deq.end() - deq.begin() != ans.size())
+            return false;
+
+        // and the deque keeps working
+        deq.insert(deq.begin() + pos, vec.begin(), vec.end());
+        ans.insert(ans.begin() + pos, vec.begin(), vec.end());
+        deq.erase(deq.begin() + pos / 2, deq.begin() + pos / 2 + 50);
+        ans.erase(ans.begin() + pos / 2, ans.begin() + pos / 2 + 50);
+        if (!isEqual(ans, deq))
+            return false;
+    }
+    return true;
+}
+
+bool eraseRangeTest() {
+    std::deque<int> ans;
+    sjtu::deque<int> deq;
+
+    randnumFill(ans, deq, MAX_N * 4);
+
+    while (!ans.empty()) {
+        int l = randnum() % ans.size();
+        int r = l + randnum() % (ans.size() - l > 3000 ? 3000 : ans.size() - l + 1);
+
+        auto it = deq.erase(deq.begin() + l, deq.begin() + r);
+        auto ansIt = ans.erase(ans.begin() + l, ans.begin() + r);
+        if (it - deq.begin() != ansIt - ans.begin())
+            return false;
+        if (ansIt != ans.end() && *ansIt != *it)
+            return false;
+        if (randnum() % 10 == 0 && !isEqual(ans, deq))
+            return false;
+    }
+
+    deq.erase(deq.begin(), deq.end());
+    return isEqual(ans, deq) && deq.empty();
+}
+
+// counts copies, so that moving insertions can be told apart
+struct Counted {
+    static int copies;
+    int a, b;
+    Counted(int a = 0, int b = 0) : a(a), b(b) {}
+    Counted(const Counted &other) : a(other.a), b(other.b) { ++copies; }
+    Counted(Counted &&other) noexcept : a(other.a), b(other.b) { other.a = other.b = -1; }
+    Counted &operator=(const Counted &other) { a = other.a; b = other.b; ++copies; return *this; }
+    Counted &operator=(Counted &&other) noexcept { a = other.a; b = other.b; other.a = other.b = -1; return *this; }
+    bool operator!=(const Counted &other) const { return a != other.a || b != other.b; }
+};
+int Counted::copies = 0;
+
+bool emplaceTest() {
+    std::deque<Counted> ans;
+    sjtu::deque<Counted> deq;
+
+    for (int i = 0; i < MAX_N; i++) {
+        int x = randnum() % 1000, y = randnum() % 1000;
+        int pos = randnum() % (ans.size() + 1);
+        Counted c(x, y), d(x, y);
+        switch (randnum() % 6) {
+            case 0: if (deq.emplace_back(x, y) != Counted(x, y))
+                        return false;
+                    ans.emplace_back(x, y);
+                    break;
+            case 1: if (deq.emplace_front(x, y) != Counted(x, y))
+                        return false;
+                    ans.emplace_front(x, y);
+                    break;
+            case 2: if (*deq.emplace(deq.begin() + pos, x, y) != Counted(x, y))
+                        return false;
+                    ans.emplace(ans.begin() + pos, x, y);
+                    break;
+            case 3: deq.push_back(std::move(c)); ans.push_back(std::move(d));
+                    break;
+            case 4: deq.push_front(std::move(c)); ans.push_front(std::move(d));
+                    break;
+            case 5: if (*deq.insert(deq.begin() + pos, std::move(c)) != Counted(x, y))
+                        return false;
+                    ans.insert(ans.begin() + pos, std::move(d));
+                    break;
+        }
+        // the moved-from source is left in its moved-from state
+        if (c.a != d.a)
+            return false;
+    }
+    // std::deque never copies here either
+    if (Counted::copies != 0 || !isEqual(ans, deq))
+        return false;
+
+    // move-only elements
+    sjtu::deque<std::unique_ptr<int>> ptrs;
+    std::deque<int> values;
+    for (int i = 0; i < MAX_N; i++) {
+        int pos = randnum() % (values.size() + 1);
+        switch (randnum() % 4) {
+            case 0: ptrs.push_back(std::make_unique<int>(i)); values.push_back(i);
+                    break;
+            case 1: ptrs.emplace_front(new int(i)); values.push_front(i);
+                    break;
+            case 2: ptrs.insert(ptrs.begin() + pos, std::make_unique<int>(i));
+                    values.insert(values.begin() + pos, i);
+                    break;
+            case 3: if (pos < values.size()) {
+                        ptrs.erase(ptrs.begin() + pos);
+                        values.erase(values.begin() + pos);
+                    }
+                    break;
+        }
+    }
+    if (ptrs.size() != values.size())
+        return false;
+    for (int i = 0; i < values.size(); i++)
+        if (*ptrs[i] != values[i])
+            return false;
+    return true;
+}
+
+// leaves deq in the moved-from state
+template <typename Deq>
+void moveAway(Deq &deq) {
+    Deq other(std::move(deq));
+}
+
+template <typename Func>
+bool throws(Func func) {
+    try {
+        func();
+    } catch (...) {
+        return true;
+    }
+    return false;
+}
+
+bool moveAndSwapTest() {
+    std::deque<int> ans, ans2;
+    sjtu::deque<int> deq, deq2;
+    randnumFill(ans, deq);
+    randnumFill(ans2, deq2, MAX_N / 3);
+
+    // iterators follow their elements into the other deque
+    auto it = deq.begin() + 100;
+    deq.swap(deq2);
+    std::swap(ans, ans2);
+    if (!isEqual(ans, deq) || !isEqual(ans2, deq2) || *it != ans2[100] || it - deq2.begin() != 100)
+        return false;
+    swap(deq, deq2);
+    std::swap(ans, ans2);
+
+    sjtu::deque<int> moved(std::move(deq));
+    if (!isEqual(ans, moved) || *it != ans[100] || !deq.empty())
+        return false;
+    deq2 = std::move(moved);
+    if (!isEqual(ans, deq2) || !moved.empty())
+        return false;
+    deq2 = std::move(deq2);
+    if (!isEqual(ans, deq2))
+        return false;
+
+    // every entry point of a moved-from deque
+    std::deque<int> none;
+    moveAway(deq);
+    if (deq.size() != 0 || !deq.empty() || deq.begin() != deq.end() || deq.cbegin() != deq.cend() ||
+        deq.capacity() != 0 || deq.block_count() != 0 || !isEqual(none, deq))
+        return false;
+    if (!throws([&] { deq.front(); }) || !throws([&] { deq.back(); }) || !throws([&] { deq.at(0); }) ||
+        !throws([&] { deq[0]; }) || !throws([&] { deq.pop_back(); }) || !throws([&] { deq.pop_front(); }) ||
+        !throws([&] { deq.erase(deq.begin()); }) || !throws([&] { deq.set(0, 1); }))
+        return false;
+    deq.erase(deq.begin(), deq.end());
+    deq.clear();
+    deq.resize(0);
+    deq.shrink_to_fit();
+    deq.set_spare_limit(0);
+    sjtu::deque<int> copy(deq);
+    copy = deq;
+    deq = copy;
+    deq = std::move(copy);
+    deq.swap(copy);
+    if (!isEqual(none, deq) || !isEqual(none, copy))
+        return false;
+
+    moveAway(deq);
+    deq.push_back(1); deq.push_front(0); deq.emplace_back(2);
+    if (deq.size() != 3 || deq[0] != 0 || deq[2] != 2)
+        return false;
+    moveAway(deq);
+    deq.insert(deq.begin(), 5, 7);
+    moveAway(deq);
+    deq.insert(deq.end(), ans.begin(), ans.end());
+    if (!isEqual(ans, deq))
+        return false;
+    moveAway(deq);
+    deq.resize(10, 3);
+    moveAway(deq);
+    deq.reserve(1000);
+    if (deq.capacity() < 1000)
+        return false;
+    moveAway(deq);
+    // a moved-from deque takes moves and swaps like any other
+    deq = std::move(deq2);
+    if (!isEqual(ans, deq))
+        return false;
+    deq.swap(deq2);
+    if (!isEqual(ans, deq2) || !isEqual(none, deq))
+        return false;
+
+    // range queries and updates on a moved-from deque
+    sjtu::deque<long long, std::allocator<long long>, sjtu::sqrt_layout, sjtu::sum_aggregate<long long>, true> sums;
+    sums.push_back(1);
+    moveAway(sums);
+    if (sums.aggregate(0, 0) != 0 || !throws([&] { sums.aggregate(0, 1); }))
+        return false;
+    sums.range_add(0, 0, 5);
+    sums.range_assign(0, 0, 5);
+    if (!throws([&] { sums.range_add(0, 1, 5); }) || !sums.empty())
+        return false;
+    sums.push_back(4);
+    return sums.aggregate(0, 1) == 4;
+}
+
+// sums the values of Fragile elements
+struct FragileSum {
+    typedef long long value_type;
+    static long long identity() { return 0; }
+    static long long lift(const Fragile &f) { return f.x; }
+    static long long combine(long long a, long long b) { return a + b; }
+};
+
+bool copyThrowTest() {
+    for (int round = 0; round < 20; round++) {
+        sjtu::deque<Fragile> src;
+        std::deque<Fragile> ans;
+        for (int i = 0; i < 1000; i++) {
+            src.push_back(Fragile(i)); ans.push_back(Fragile(i));
+        }
+
+        // nothing is left behind by a copy constructor that throws
+        Fragile::countdown = randnum() % 1000;
+        try {
+            sjtu::deque<Fragile> copy(src);
+            Fragile::countdown = -1;
+            return false;
+        } catch (int) {}
+
+        // an assignment that throws keeps what it copied
+        sjtu::deque<Fragile, std::allocator<Fragile>, sjtu::sqrt_layout, FragileSum> sums, dst;
+        for (int i = 0; i < 1000; i++)
+            sums.push_back(Fragile(i));
+        dst.push_back(Fragile(-1));
+        Fragile::countdown = randnum() % 1000;
+        try {
+            dst = sums;
+            Fragile::countdown = -1;
+            return false;
+        } catch (int) {}
+        Fragile::countdown = -1;
+
+        int k = dst.size();
+        long long sum = 0;
+        for (int i = 0; i < k; i++) {
+            if (dst[i].x != i)
+                return false;
+            sum += i;
+        }
+        if (dst.end() - dst.begin() != k || dst.aggregate(0, k) != sum)
+            return false;
+        if (!isEqual(ans, src))
+            return false;
+    }
+    return true;
+}
+
+bool pmrTest() {
+    std::pmr::monotonic_buffer_resource pool;
+    std::deque<int> ans;
+    sjtu::pmr::deque<int> deq(&pool);
+
+    randnumFill(ans, deq, MAX_N);
+    for (int i = 0; i < 100; i++) {
+        int pos = randnum() % (ans.size() + 1);
+        deq.insert(deq.begin() + pos, i);
+        ans.insert(ans.begin() + pos, i);
+    }
+    if (deq.get_allocator().resource() != &pool || !isEqual(ans, deq))
+        return false;
+
+    // copies take the default resource, moves keep the pool
+    sjtu::pmr::deque<int> copy(deq);
+    sjtu::pmr::deque<int> moved(std::move(deq));
+    if (copy.get_allocator().resource() != std::pmr::get_default_resource() ||
+        moved.get_allocator().resource() != &pool || !isEqual(ans, copy) || !isEqual(ans, moved))
+        return false;
+
+    // elements built in place get the resource too
+    sjtu::pmr::deque<std::pmr::vector<int>> vecs(&pool);
+    vecs.emplace_back(10, 1);
+    vecs.emplace_front(5, 2);
+    return vecs.front().get_allocator().resource() == &pool && vecs.back().size() == 10;
+}
+
+// counts the allocations made through it
+struct CountingResource : std::pmr::memory_resource {
+    int allocs = 0, live = 0;
+    void *do_allocate(size_t bytes, size_t align) override {
+        ++allocs; ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t align) override {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// pushes and pops count elements at both ends, rounds times
+template <typename Ans, typename Test>
+void oscillate(Ans &ans, Test &test, int rounds, int count) {
+    for (int i = 0; i < rounds; i++) {
+        for (int j = 0; j < count; j++) {
+            test.push_back(j); ans.push_back(j);
+            test.push_front(j); ans.push_front(j);
+        }
+        for (int j = 0; j < count; j++) {
+            test.pop_back(); ans.pop_back();
+            test.pop_front(); ans.pop_front();
+        }
+    }
+}
+
+bool spareTest() {
+    CountingResource res;
+    {
+        std::deque<int> ans;
+        sjtu::pmr::deque<int> deq(&res);
+        randnumFill(ans, deq, 10000);
+        if (deq.spare_limit() != 2)
+            return false;
+
+        // once emptied blocks are cached, oscillating allocates nothing
+        oscillate(ans, deq, 1, 50);
+        int allocs = res.allocs;
+        oscillate(ans, deq, 1000, 50);
+        if (res.allocs != allocs || !isEqual(ans, deq))
+            return false;
+
+        // without the cache the spares are freed, nothing is kept and
+        // runs longer than a block allocate every time
+        int live = res.live;
+        deq.set_spare_limit(0);
+        if (deq.spare_limit() != 0 || res.live > live)
+            return false;
+        live = res.live;
+        oscillate(ans, deq, 10, 1000);
+        if (res.allocs == allocs || res.live > live || !isEqual(ans, deq))
+            return false;
+
+        deq.set_spare_limit(8);
+        oscillate(ans, deq, 1, 50);
+        allocs = res.allocs;
+        oscillate(ans, deq, 100, 50);
+        if (res.allocs != allocs || !isEqual(ans, deq))
+            return false;
+    }
+    return res.live == 0;
+}
+
+bool capacityTest() {
+    std::deque<int> ans;
+    sjtu::deque<int> deq;
+
+    randnumFill(ans, deq, 1000);
+
+    deq.reserve(MAX_N * 10);
+    if (deq.capacity() < MAX_N * 10)
+        return false;
+
+    // growing up to the reserved amount allocates nothing more
+    size_t capa = deq.capacity();
+    randnumFill(ans, deq, MAX_N * 10 - 1000);
+    if (deq.capacity() != capa || !isEqual(ans, deq))
+        return false;
+
+    // the room survives pops
+    for (int i = 0; i < MAX_N * 9; i++) {
+        if (randnum() % 2) {
+            deq.pop_back(); ans.pop_back();
+        } else {
+            deq.pop_front(); ans.pop_front();
+        }
+    }
+    if (deq.capacity() < MAX_N * 10)
+        return false;
+
+    deq.shrink_to_fit();
+    if (deq.capacity() < deq.size() || deq.capacity() >= capa || !isEqual(ans, deq))
+        return false;
+
+    deq.clear(); ans.clear();
+    deq.shrink_to_fit();
+    randnumFill(ans, deq, 100);
+
+    return isEqual(ans, deq);
+}
+
+bool resizeTest() {
+    std::deque<long long> ans;
+    sjtu::deque<long long> deq;
+
+    for (int i = 0; i < 200; i++) {
+        int n = randnum() % (2 * MAX_N);
+        if (randnum() % 2) {
+            deq.resize(n);
+            ans.resize(n);
+        } else {
+            long long x = randnum();
+            deq.resize(n, x);
+            ans.resize(n, x);
+        }
+        if (randnum() % 2)
+            randnumFill(ans, deq, 100);
+        if (!isEqual(ans, deq))
+            return false;
+    }
+
+    // value may be an element of the deque
+    if (!deq.empty()) {
+        deq.resize(deq.size() * 3, deq.front());
+        ans.resize(ans.size() * 3, ans.front());
+    }
+
+    return isEqual(ans, deq);
+}
+
+bool tieredTest() {
+    std::deque<int> ans;
+    sjtu::deque<int, std::allocator<int>, sjtu::tiered_layout> deq;
+
+    randnumFill(ans, deq, MAX_N * 2);
+
+    for (int i = 0; i < MAX_N * 2; i++) {
+        int pos = randnum() % (ans.size() + 1);
+        int x = randnum();
+        switch (randnum() % 6) {
+            case 0: case 1:
+                deq.insert(deq.begin() + pos, x);
+                ans.insert(ans.begin() + pos, x);
+                break;
+            case 2: case 3:
+                if (pos < ans.size()) {
+                    deq.erase(deq.begin() + pos);
+                    ans.erase(ans.begin() + pos);
+                }
+                break;
+            case 4:
+                if (pos < ans.size() && deq[pos] != ans[pos])
+                    return false;
+                break;
+            case 5:
+                if (randnum() % 2) {
+                    deq.push_front(x); ans.push_front(x);
+                } else if (!ans.empty()) {
+                    deq.pop_back(); ans.pop_back();
+                }
+                break;
+        }
+    }
+    if (!isEqual(ans, deq))
+        return false;
+
+    // bulk operations keep the tiers consistent too
+    std::vector<int> vec(MAX_N, 7);
+    deq.insert(deq.begin() + ans.size() / 2, vec.begin(), vec.end());
+    ans.insert(ans.begin() + ans.size() / 2, vec.begin(), vec.end());
+    deq.erase(deq.begin() + 100, deq.begin() + MAX_N);
+    ans.erase(ans.begin() + 100, ans.begin() + MAX_N);
+    deq.resize(MAX_N * 2, 3);
+    ans.resize(MAX_N * 2, 3);
+    if (!isEqual(ans, deq))
+        return false;
+
+    // drain it from the middle
+    while (!ans.empty()) {
+        int pos = ans.size() / 2;
+        deq.erase(deq.begin() + pos);
+        ans.erase(ans.begin() + pos);
+        if (ans.size() % 1000 == 0 && !isEqual(ans, deq))
+            return false;
+    }
+    return deq.empty();
+}
+
+template <typename Aggregate, typename Op>
+bool aggregateCase(long long init, Op op) {
+    std::deque<long long> ans;
+    sjtu::deque<long long, std::allocator<long long>, sjtu::sqrt_layout, Aggregate> deq;
+
+    randnumFill(ans, deq, MAX_N);
+
+    for (int i = 0; i < MAX_N; i++) {
+        int pos = randnum() % (ans.size() + 1);
+        long long x = randnum() % 1000;
+        switch (randnum() % 6) {
+            case 0: deq.insert(deq.begin() + pos, x);
+                    ans.insert(ans.begin() + pos, x);
+                    break;
+            case 1: if (pos < ans.size()) {
+                        deq.erase(deq.begin() + pos);
+                        ans.erase(ans.begin() + pos);
+                    }
+                    break;
+            case 2: if (pos < ans.size()) {
+                        deq.set(pos, x);
+                        ans[pos] = x;
+                    }
+                    break;
+            case 3: if (randnum() % 2) {
+                        deq.push_back(x); ans.push_back(x);
+                    } else if (!ans.empty()) {
+                        deq.pop_front(); ans.pop_front();
+                    }
+                    break;
+            default: {
+                const auto &cdeq = deq;
+                int l = randnum() % (ans.size() + 1);
+                int r = l + randnum() % (ans.size() - l + 1);
+                long long want = init;
+                for (int j = l; j < r; j++)
+                    want = op(want, ans[j]);
+                if (cdeq.aggregate(l, r) != want)
+                    return false;
+            }
+        }
+    }
+
+    return isEqual(ans, deq);
+}
+
+bool aggregateTest() {
+    return aggregateCase<sjtu::sum_aggregate<long long>>(0, [](long long a, long long b) { return a + b; }) &&
+           aggregateCase<sjtu::min_aggregate<long long>>(std::numeric_limits<long long>::max(),
+                                                         [](long long a, long long b) { return b < a ? b : a; }) &&
+           aggregateCase<sjtu::max_aggregate<long long>>(std::numeric_limits<long long>::lowest(),
+                                                         [](long long a, long long b) { return a < b ? b : a; });
+}
+
+// += throws once countdown runs out
+struct Brittle {
+    static int countdown;
+    long long x;
+    Brittle(long long x = 0) : x(x) {}
+    Brittle &operator+=(const Brittle &other) {
+        if (countdown >= 0 && countdown-- == 0)
+            throw 1;
+        x += other.x;
+        return *this;
+    }
+};
+int Brittle::countdown = -1;
+
+// sums Brittle elements; without add and assign, updated blocks are refolded
+struct BrittleSum {
+    typedef long long value_type;
+    static long long identity() { return 0; }
+    static long long lift(const Brittle &b) { return b.x; }
+    static long long combine(long long a, long long b) { return a + b; }
+};
+
+typedef sjtu::deque<int> PlainDeque;
+typedef sjtu::deque<Brittle, std::allocator<Brittle>, sjtu::sqrt_layout, BrittleSum, true> TaggedDeque;
+static_assert(noexcept(std::declval<PlainDeque::iterator &>().operator->()), "plain iterators stay noexcept");
+static_assert(noexcept(std::declval<PlainDeque::const_iterator &>().operator->()), "plain iterators stay noexcept");
+static_assert(!noexcept(std::declval<TaggedDeque::iterator &>().operator->()), "applying a tag may throw");
+
+// a tag whose += throws while it is applied leaves a consistent deque
+bool rangeThrowTest() {
+    for (int round = 0; round < 20; round++) {
+        TaggedDeque deq;
+        deq.resize(1000);
+        deq.range_add(0, 1000, Brittle(1));
+        Brittle::countdown = randnum() % 40;
+        try {
+            for (auto it = deq.begin(); it != deq.end(); ++it)
+                if (it->x > 1)
+                    return false;
+            Brittle::countdown = -1;
+            return false;
+        } catch (int) {}
+        Brittle::countdown = -1;
+
+        // no element got the delta twice, and the sums follow the elements
+        long long sum = 0;
+        for (int i = 0; i < 1000; i++) {
+            if (deq[i].x != 0 && deq[i].x != 1)
+                return false;
+            sum += deq[i].x;
+        }
+        if (deq.aggregate(0, 1000) != sum || deq.aggregate(0, 500) + deq.aggregate(500, 1000) != sum)
+            return false;
+    }
+    return true;
+}
+
+bool rangeUpdateTest() {
+    std::deque<long long> ans;
+    sjtu::deque<long long, std::allocator<long long>, sjtu::sqrt_layout, sjtu::sum_aggregate<long long>, true> deq;
+
+    randnumFill(ans, deq, MAX_N);
+
+    for (int i = 0; i < MAX_N; i++) {
+        int l = randnum() % (ans.size() + 1);
+        int r = l + randnum() % (ans.size() - l + 1);
+        long long x = randnum() % 1000;
+        switch (randnum() % 5) {
+            case 0: deq.range_add(l, r, x);
+                    for (int j = l; j < r; j++) ans[j] += x;
+                    break;
+            case 1: deq.range_assign(l, r, x);
+                    for (int j = l; j < r; j++) ans[j] = x;
+                    break;
+            case 2: deq.insert(deq.begin() + l, x);
+                    ans.insert(ans.begin() + l, x);
+                    break;
+            case 3: if (l < ans.size()) {
+                        deq.erase(deq.begin() + l);
+                        ans.erase(ans.begin() + l);
+                    }
+                    break;
+            case 4: {
+                long long want = 0;
+                for (int j = l; j < r; j++)
+                    want += ans[j];
+                if (deq.aggregate(l, r) != want)
+                    return false;
+            }
+        }
+    }
+
+    // the value may be an element in the range
+    deq.range_assign(0, deq.size(), deq[deq.size() / 2]);
+    long long x = ans[ans.size() / 2];
+    for (auto &y : ans) y = x;
+    if (deq.aggregate(0, deq.size()) != x * (long long)ans.size())
+        return false;
+
+    // without an aggregator, elements stay writable
+    std::deque<int> ans2;
+    sjtu::deque<int, std::allocator<int>, sjtu::sqrt_layout, sjtu::no_aggregate, true> deq2;
+    randnumFill(ans2, deq2, MAX_N);
+    deq2.range_add(10, MAX_N - 10, 7);
+    for (int j = 10; j < MAX_N - 10; j++) ans2[j] += 7;
+    deq2[MAX_N / 2] = 5; ans2[MAX_N / 2] = 5;
+    *(deq2.begin() + 20) = 6; ans2[20] = 6;
+
+    return isEqual(ans, deq) && isEqual(ans2, deq2) && rangeThrowTest();
+}
+
+bool monotonicTest() {
+    std::deque<int> ans;
+    sjtu::monotonic_deque<int> deq;
+
+    for (int i = 0; i < MAX_N * 4; i++) {
+        if (ans.empty() || randnum() % 3) {
+            // few distinct values, so that equal elements are common
+            int x = randnum() % 100;
+            deq.push_back(x); ans.push_back(x);
+        } else {
+            deq.pop_front(); ans.pop_front();
+        }
+        // keep the window short enough to check by brute force
+        if (ans.size() > 200) {
+            deq.pop_front(); ans.pop_front();
+        }
+        if (deq.size() != ans.size())
+            return false;
+        if (ans.empty())
+            continue;
+        int lo = ans[0], hi = ans[0];
+        for (int j = 1; j < ans.size(); j++) {
+            lo = std::min(lo, ans[j]);
+            hi = std::max(hi, ans[j]);
+        }
+        if (deq.min() != lo || deq.max() != hi)
+            return false;
+    }
+
+    deq.clear();
+    if (!deq.empty())
+        return false;
+    try {
+        deq.min();
+        return false;
+    } catch (...) {}
+
+    // the candidates come from a memory resource too
+    std::pmr::monotonic_buffer_resource pool;
+    sjtu::pmr::monotonic_deque<int> window(std::less<int>(), &pool);
+    for (int i = 0; i < 1000; i++)
+        window.push_back(i % 37);
+    for (int i = 0; i < 990; i++)
+        window.pop_front();
+    // the last ten are 990 % 37 .. 999 % 37, i.e. 28 .. 36 and 0
+    return window.get_allocator().resource() == &pool && window.min() == 0 && window.max() == 36;
+}
+
+int main() {
+    bool (*testFunc[])()= {
+        insertRangeTest,
+        insertThrowTest,
+        eraseRangeTest,
+        emplaceTest,
+        moveAndSwapTest,
+        copyThrowTest,
+        pmrTest,
+        spareTest,
+        capacityTest,
+        resizeTest,
+        tieredTest,
+        aggregateTest,
+        rangeUpdateTest,
+        monotonicTest,
+    };
+
+    const char *testMessage[] = {
+        "Testing range insert...",
+        "Testing insert with throwing copies...",
+        "Testing range erase...",
+        "Testing emplace and move insertion...",
+        "Testing move and swap...",
+        "Testing copy with throwing copies...",
+        "Testing pmr deque...",
+        "Testing spare blocks...",
+        "Testing capacity...",
+        "Testing resize...",
+        "Testing tiered layout...",
+        "Testing aggregate...",
+        "Testing range update...",
+        "Testing monotonic deque...",
+    };
+
+    bool error = false;
+    for (int i = 0; i < sizeof(testFunc) / sizeof(testFunc[0]); i++) {
+        printf("%-40s", testMessage[i]);
+        if (testFunc[i]())
+            printf("Passed\n");
+        else {
+            error = true;
+            printf("Failed !!!\n");
+        }
+    }
+
+    if (error)
+        printf("\nUnfortunately, you failed in this test\n\a");
+    else
+        printf("\nCongratulations, your deque passed all the tests!\n");
+
+    return 0;
+}